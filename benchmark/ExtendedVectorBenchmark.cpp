@@ -0,0 +1,301 @@
+#include "../extended-vector/ExtendedVector.h"
+#include "../extended-vector/ChunkedStorage.h"
+#include "../extended-vector/ConcurrentExtendedVector.h"
+#include "../extended-vector/CompressedStorage.h"
+#include "../extended-vector/SetOperations.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+using std::string;
+using std::vector;
+
+/// Benchmark of the ExtendedVector search modes and storages. Every section prints its timings; the
+/// values are drawn from fixed seeds, so two runs measure the same work. A section stops the
+/// benchmark when a result is wrong.
+///
+/// Usage: extendedVectorBenchmark [section...], all the sections by default:
+///        searchModes removeFirstFound concurrentReaders setOperations compressedStorage
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    [[noreturn]] void fail(const string &message)
+    {
+        std::cerr << message << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    void check(bool condition, const string &section)
+    {
+        if (!condition)
+            fail("Wrong result in " + section);
+    }
+
+    vector<int> sortedRandomValues(int size, int maximum, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> value(0, maximum);
+        vector<int> values(size);
+        for (auto &item : values)
+            item = value(generator);
+
+        std::sort(begin(values), end(values));
+        return values;
+    }
+
+    /// Time of a lookup in every search mode.
+    void searchModes()
+    {
+        const int size = 1 << 22;
+        const int lookups = 1 << 20;
+        ExtendedVector<int> extended(sortedRandomValues(size, size * 4, 3));
+        vector<int> queries = sortedRandomValues(lookups, size * 4, 5);
+        std::shuffle(begin(queries), end(queries), std::mt19937(7));
+        vector<int> indices(lookups);
+
+        auto measure = [&](SearchMode mode, bool batch)
+        {
+            extended.setSearchMode(mode);
+            extended.find(queries[0]);
+            const auto start = Clock::now();
+            if (batch)
+                extended.find(span<const int>(queries), span<int>(indices));
+            else
+                for (int i = 0; i < lookups; i++)
+                    indices[i] = extended.find(queries[i]);
+            const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            return elapsed.count() / lookups;
+        };
+
+        const double binary = measure(BINARY_SEARCH, false);
+        const vector<int> expected{indices};
+        auto checkFound = [&]()
+        {
+            for (int i = 0; i < lookups; i++)
+                check((indices[i] >= 0) == (expected[i] >= 0), "searchModes");
+        };
+
+        const double branchless = measure(BRANCHLESS_SEARCH, false);
+        const double eytzinger = measure(EYTZINGER_SEARCH, false);
+        const double batch = measure(EYTZINGER_SEARCH, true);
+        checkFound();
+        const double kary = measure(KARY_SEARCH, false);
+        checkFound();
+        const double learned = measure(LEARNED_SEARCH, false);
+        checkFound();
+
+        std::cout << "ns per lookup - binary search: " << binary << ", branchless: " << branchless
+                  << ", eytzinger: " << eytzinger << ", eytzinger batch: " << batch << ", k-ary: " << kary
+                  << ", learned: " << learned << " (maximum error " << extended.learnedIndex().maximumError() << ")" << std::endl;
+    }
+
+    /// Time of removeFirstFound with the vector and the chunked storages.
+    void removeFirstFound()
+    {
+        const int size = 1 << 20;
+        const int removals = 5000;
+        vector<int> values = sortedRandomValues(size, size * 4, 29);
+        vector<int> removed{begin(values), begin(values) + removals};
+        std::shuffle(begin(removed), end(removed), std::mt19937(31));
+
+        auto measure = [&](auto &extended)
+        {
+            extended.setSearchMode(BRANCHLESS_SEARCH);
+            const auto start = Clock::now();
+            for (int item : removed)
+                extended.removeFirstFound(int(item));
+            const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            check(extended.count() == size - removals, "removeFirstFound");
+            return elapsed.count() / removals;
+        };
+
+        ExtendedVector<int> contiguous(values);
+        ExtendedVector<int, ChunkedStorage<int>> chunked(values);
+        const double contiguousTime = measure(contiguous);
+        const double chunkedTime = measure(chunked);
+        check(std::equal(contiguous.begin(), contiguous.end(), chunked.begin(), chunked.end()), "removeFirstFound");
+
+        std::cout << "ns per removeFirstFound - vector storage: " << contiguousTime << ", chunked storage: " << chunkedTime << std::endl;
+    }
+
+    /// Lookups per second of concurrent readers, with snapshots and with a mutex.
+    void concurrentReaders()
+    {
+        const int size = 1 << 20;
+        const int lookups = 1 << 19;
+        vector<int> values = sortedRandomValues(size, size * 4, 23);
+        ConcurrentExtendedVector<int> shared(vector<int>(values), SORT, KARY_SEARCH);
+        ExtendedVector<int> locked(vector<int>(values), SORT, KARY_SEARCH);
+        std::mutex lock;
+
+        // Lookups per second of <<threadCount>> readers, while a writer publishes a change every millisecond
+        auto measure = [&](int threadCount, bool withMutex)
+        {
+            std::atomic<bool> done{false};
+            std::thread writer([&]()
+                               {
+                                   for (int value = 1; !done; value++)
+                                   {
+                                       if (withMutex)
+                                       {
+                                           std::lock_guard<std::mutex> guard(lock);
+                                           locked.insert(-value);
+                                           locked.prepareSearches();
+                                       }
+                                       else
+                                       {
+                                           shared.insert(-value);
+                                           shared.publish();
+                                       }
+                                       std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                                   } });
+
+            const auto start = Clock::now();
+            vector<std::thread> readers;
+            for (int reader = 0; reader < threadCount; reader++)
+                readers.emplace_back([&, reader]()
+                                     {
+                                         std::mt19937 random(reader);
+                                         for (int i = 0; i < lookups / threadCount; i++)
+                                         {
+                                             const int value = random() % (size * 4);
+                                             if (withMutex)
+                                             {
+                                                 std::lock_guard<std::mutex> guard(lock);
+                                                 locked.find(value);
+                                             }
+                                             else
+                                                 shared.find(value);
+                                         } });
+            for (std::thread &reader : readers)
+                reader.join();
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            done = true;
+            writer.join();
+            return lookups / elapsed.count();
+        };
+
+        for (int threadCount : {1, 2, 4})
+            std::cout << threadCount << " readers - lookups per second with snapshots: " << measure(threadCount, false)
+                      << ", with a mutex: " << measure(threadCount, true) << std::endl;
+    }
+
+    /// Time of the intersection and of the difference of sorted sets, scalar and SIMD.
+    void setOperations()
+    {
+        const int size = 1 << 20;
+        const int repetitions = 20;
+        const ExtendedVector<int> a(sortedRandomValues(size, size * 4, 29), SORT_UNIQUE);
+        const ExtendedVector<int> b(sortedRandomValues(size, size * 4, 31), SORT_UNIQUE);
+        const ExtendedVector<int> small(sortedRandomValues(size / 1000, size * 4, 37), SORT_UNIQUE);
+        vector<int> output(size);
+        span<const int> aKeys = a.storage().view(), bKeys = b.storage().view(), smallKeys = small.storage().view();
+
+        auto measure = [&](auto operation)
+        {
+            size_t written = 0;
+            const auto start = Clock::now();
+            for (int i = 0; i < repetitions; i++)
+                written = operation();
+            const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+            check(written > 0, "setOperations");
+            return elapsed.count() / repetitions;
+        };
+
+        const double scalar = measure([&]()
+                                      { return SetKernels::scalar::intersect(aKeys.data(), aKeys.size(), bKeys.data(), bKeys.size(), output.data()); });
+        const double simd = measure([&]()
+                                    { return sortedIntersection(a, b, span<int>(output)); });
+        const double merge = measure([&]()
+                                     { return SetKernels::scalar::intersect(smallKeys.data(), smallKeys.size(), aKeys.data(), aKeys.size(), output.data()); });
+        const double galloping = measure([&]()
+                                         { return sortedIntersection(small, a, span<int>(output)); });
+        const double difference = measure([&]()
+                                          { return sortedDifference(a, b, span<int>(output)); });
+
+        std::cout << "ms per intersection of 1M keys - scalar: " << scalar << ", simd: " << simd
+                  << "; of 1k and 1M keys - merge: " << merge << ", galloping: " << galloping
+                  << "; ms per simd difference: " << difference << std::endl;
+    }
+
+    /// Memory, lookup and iteration time of the compressed storage against the vector storage.
+    void compressedStorage()
+    {
+        const int size = 1 << 24;
+        const int lookups = 1 << 20;
+        std::mt19937 random(43);
+        vector<int> ids(size);
+        for (int i = 1; i < size; i++)
+            ids[i] = ids[i - 1] + 1 + random() % 4;
+        vector<int> queries(lookups);
+        for (int &query : queries)
+            query = random() % ids.back();
+
+        ExtendedVector<int> plain(vector<int>(ids), SORT);
+        ExtendedVector<int, CompressedStorage<int>> compressed(vector<int>(ids), SORT);
+
+        auto measure = [&](auto &extended, SearchMode mode)
+        {
+            extended.setSearchMode(mode);
+            long long found = 0;
+            const auto start = Clock::now();
+            for (int query : queries)
+                found += extended.find(query) >= 0;
+            const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+            check(found > 0, "compressedStorage");
+            return elapsed.count() / lookups;
+        };
+
+        auto iterate = [](auto &extended)
+        {
+            long long sum = 0;
+            const auto start = Clock::now();
+            for (int id : extended)
+                sum += id;
+            const std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+            check(sum > 0, "compressedStorage");
+            return elapsed.count();
+        };
+
+        std::cout << "MB - vector storage: " << size * sizeof(int) / 1e6 << ", compressed: " << compressed.storage().memoryBytes() / 1e6
+                  << "; ns per binarySearch - vector: " << measure(plain, BINARY_SEARCH) << ", compressed: " << measure(compressed, BINARY_SEARCH)
+                  << "; ns per branchless find - vector: " << measure(plain, BRANCHLESS_SEARCH) << ", compressed: " << measure(compressed, BRANCHLESS_SEARCH)
+                  << "; ms per iteration - vector: " << iterate(plain) << ", compressed: " << iterate(compressed) << std::endl;
+    }
+
+    struct Section
+    {
+        string name;
+        void (*run)();
+    };
+
+    const Section sections[] = {
+        {"searchModes", searchModes},
+        {"removeFirstFound", removeFirstFound},
+        {"concurrentReaders", concurrentReaders},
+        {"setOperations", setOperations},
+        {"compressedStorage", compressedStorage},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> selected(argv + 1, argv + argc);
+    for (const string &name : selected)
+        if (std::none_of(std::begin(sections), std::end(sections), [&name](const Section &section)
+                         { return section.name == name; }))
+            fail("Unknown section " + name);
+
+    for (const Section &section : sections)
+        if (selected.empty() || std::find(begin(selected), end(selected), section.name) != end(selected))
+            section.run();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,362 @@
+#include "../routing/TwoOpt.h"
+#include "../routing/TwoOptSearch.h"
+#include "../routing/ReversibleTour.h"
+#include "../routing/DistanceOracle.h"
+#include "../routing/NeighbourLists.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+using std::string;
+using std::vector;
+
+/// Benchmark of the two-opt move and the local searches built on it. For each generator and size it
+/// measures the latency of a single move, the throughput of a neighbour-list local search run to its
+/// local optimum and the memory footprint, and prints everything as JSON so that two builds can be
+/// compared. Every instance and every move is drawn from the seed, so two runs measure the same work.
+///
+/// Usage: routingBenchmark [--sizes 1000,10000,100000,1000000] [--generators random,clustered]
+///                         [--seed 1] [--moves 1000] [--neighbours 8] [--output results.json]
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double SIDE = 1000000.0;
+
+    struct Options
+    {
+        vector<int> sizes{1000, 10000, 100000, 1000000};
+        vector<string> generators{"random", "clustered"};
+        unsigned seed{1};
+        int moves{1000};
+        int neighbours{8};
+        string output;
+    };
+
+    struct Result
+    {
+        string generator;
+        int size;
+        double vectorMoveNanoseconds;
+        double tourMoveNanoseconds;
+        double candidateListsSeconds;
+        double searchSeconds;
+        long long evaluatedMoves;
+        long long appliedMoves;
+        double initialLength;
+        double finalLength;
+        size_t structureBytes;
+        size_t peakResidentBytes;
+    };
+
+    vector<string> splitList(const string &text)
+    {
+        vector<string> items;
+        std::stringstream stream(text);
+        for (string item; std::getline(stream, item, ',');)
+            if (!item.empty())
+                items.push_back(item);
+
+        return items;
+    }
+
+    [[noreturn]] void fail(const string &message)
+    {
+        std::cerr << message << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    /// std::stoi and std::stoul, failing with a message instead of an exception for a value that is
+    /// not a number.
+    template <class Parse>
+    auto parseNumber(const string &name, const string &value, Parse parse)
+    {
+        try
+        {
+            size_t parsed = 0;
+            const auto number = parse(value, &parsed, 10);
+            if (parsed != value.size())
+                fail("Option " + name + " has an invalid value " + value);
+            return number;
+        }
+        catch (const std::invalid_argument &)
+        {
+            fail("Option " + name + " has an invalid value " + value);
+        }
+        catch (const std::out_of_range &)
+        {
+            fail("Option " + name + " has an out of range value " + value);
+        }
+    }
+
+    int parseInt(const string &name, const string &value)
+    {
+        return parseNumber(name, value, [](const string &text, size_t *parsed, int base)
+                           { return std::stoi(text, parsed, base); });
+    }
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        if (argc % 2 == 0)
+            fail(string("Option ") + argv[argc - 1] + " has no value");
+
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            const string name = argv[i];
+            const string value = argv[i + 1];
+
+            if (name == "--sizes")
+            {
+                options.sizes.clear();
+                for (auto &item : splitList(value))
+                    options.sizes.push_back(parseInt(name, item));
+            }
+            else if (name == "--generators")
+                options.generators = splitList(value);
+            else if (name == "--seed")
+                options.seed = parseNumber(name, value, [](const string &text, size_t *parsed, int base)
+                                           { return std::stoul(text, parsed, base); });
+            else if (name == "--moves")
+                options.moves = parseInt(name, value);
+            else if (name == "--neighbours")
+                options.neighbours = parseInt(name, value);
+            else if (name == "--output")
+                options.output = value;
+            else
+                fail("Unknown option " + name);
+        }
+
+        // A two-opt move needs two elements between its indices, and the rates divide by the moves
+        for (int size : options.sizes)
+            if (size < 4)
+                fail("Sizes must be at least 4");
+        if (options.moves <= 0)
+            fail("The number of moves must be positive");
+        if (options.neighbours <= 0)
+            fail("The number of neighbours must be positive");
+
+        return options;
+    }
+
+    /// Points uniformly distributed in a SIDE x SIDE square.
+    vector<Point> randomPoints(int size, std::mt19937 &generator)
+    {
+        std::uniform_real_distribution<double> coordinate(0, SIDE);
+        vector<Point> points(size);
+        for (auto &point : points)
+            point = Point{coordinate(generator), coordinate(generator)};
+
+        return points;
+    }
+
+    /// Points around one center per thousand points, normally distributed, as in the clustered
+    /// instances of the DIMACS TSP challenge.
+    vector<Point> clusteredPoints(int size, std::mt19937 &generator)
+    {
+        const int clusterCount = std::max(1, size / 1000);
+        std::uniform_real_distribution<double> coordinate(0, SIDE);
+        std::uniform_int_distribution<int> cluster(0, clusterCount - 1);
+        std::normal_distribution<double> offset(0, SIDE / std::sqrt(clusterCount) / 10);
+
+        vector<Point> centers(clusterCount);
+        for (auto &center : centers)
+            center = Point{coordinate(generator), coordinate(generator)};
+
+        vector<Point> points(size);
+        for (auto &point : points)
+        {
+            const Point &center = centers[cluster(generator)];
+            point = Point{center.x + offset(generator), center.y + offset(generator)};
+        }
+
+        return points;
+    }
+
+    /// Route visiting the points in vertical strips, alternately upwards and downwards. It is the
+    /// usual cheap starting route for large instances: a random one makes every improving move
+    /// reverse a third of the route on average.
+    vector<int> stripRoute(const vector<Point> &points)
+    {
+        auto [minimumPoint, maximumPoint] = std::minmax_element(begin(points), end(points), [](const Point &first, const Point &second)
+                                                                { return first.x < second.x; });
+        const double minimumX = minimumPoint->x, maximumX = maximumPoint->x;
+
+        const int stripCount = std::max(1, static_cast<int>(std::sqrt(points.size() / 2.0)));
+        const double stripWidth = (maximumX - minimumX) / stripCount + 1e-9;
+        auto strip = [&](int id)
+        { return std::min(stripCount - 1, static_cast<int>((points[id].x - minimumX) / stripWidth)); };
+
+        vector<int> route(points.size());
+        std::iota(begin(route), end(route), 0);
+        std::sort(begin(route), end(route), [&](int first, int second)
+                  {
+                      const int firstStrip = strip(first), secondStrip = strip(second);
+                      if (firstStrip != secondStrip)
+                          return firstStrip < secondStrip;
+                      return firstStrip % 2 == 0 ? points[first].y < points[second].y : points[first].y > points[second].y; });
+
+        return route;
+    }
+
+    vector<TwoOptMove> randomMoves(int size, int count, std::mt19937 &generator)
+    {
+        std::uniform_int_distribution<int> index(0, size - 1);
+        vector<TwoOptMove> moves;
+        while (static_cast<int>(moves.size()) < count)
+        {
+            int firstIndex = index(generator), secondIndex = index(generator);
+            if (firstIndex > secondIndex)
+                std::swap(firstIndex, secondIndex);
+            if (secondIndex - firstIndex >= 3)
+                moves.push_back(TwoOptMove{firstIndex, secondIndex, 0});
+        }
+
+        return moves;
+    }
+
+    template <class Route>
+    double averageMoveNanoseconds(Route &route, const vector<TwoOptMove> &moves)
+    {
+        const auto start = Clock::now();
+        for (auto &move : moves)
+            twoOpt(route, move.firstIndex, move.secondIndex);
+        const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+
+        return elapsed.count() / moves.size();
+    }
+
+    double seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    size_t peakResidentBytes()
+    {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+    }
+
+    Result run(const string &generatorName, int size, const Options &options)
+    {
+        std::mt19937 generator(options.seed ^ (size * 2654435761u) ^ (generatorName == "clustered" ? 0x9e3779b9u : 0));
+        const vector<Point> points = generatorName == "clustered" ? clusteredPoints(size, generator) : randomPoints(size, generator);
+        auto distance = [&points](int from, int to)
+        { return std::hypot(points[from].x - points[to].x, points[from].y - points[to].y); };
+
+        Result result{};
+        result.generator = generatorName;
+        result.size = size;
+
+        const vector<TwoOptMove> moves = randomMoves(size, options.moves, generator);
+        vector<int> route(size);
+        std::iota(begin(route), end(route), 0);
+        result.vectorMoveNanoseconds = averageMoveNanoseconds(route, moves);
+        ReversibleTour tour(route);
+        result.tourMoveNanoseconds = averageMoveNanoseconds(tour, moves);
+
+        auto start = Clock::now();
+        CandidateLists candidates(points, options.neighbours);
+        result.candidateListsSeconds = seconds(start);
+
+        route = stripRoute(points);
+        TwoOptSearch search(distance);
+        result.initialLength = search.length(route);
+        start = Clock::now();
+        search.optimize(route, candidates);
+        result.searchSeconds = seconds(start);
+        result.finalLength = search.length(route);
+        result.evaluatedMoves = search.evaluatedMoves();
+        result.appliedMoves = search.appliedMoves();
+
+        // Points, route, search positions and candidate lists
+        result.structureBytes = size * (sizeof(Point) + 2 * sizeof(int)) + static_cast<size_t>(size) * candidates.neighboursPerElement() * sizeof(int);
+        result.peakResidentBytes = peakResidentBytes();
+        return result;
+    }
+
+    /// Zero rather than an infinity, which JSON cannot represent, for a search too short to be timed.
+    double perSecond(long long count, double seconds)
+    {
+        return seconds > 0 ? count / seconds : 0;
+    }
+
+    void writeJson(std::ostream &output, const Options &options, const vector<Result> &results)
+    {
+        output << "{\n";
+        output << "  \"benchmark\": \"routing\",\n";
+        output << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#ifdef NDEBUG
+        output << "  \"assertions\": false,\n";
+#else
+        output << "  \"assertions\": true,\n";
+#endif
+        output << "  \"seed\": " << options.seed << ",\n";
+        output << "  \"moves\": " << options.moves << ",\n";
+        output << "  \"neighbours\": " << options.neighbours << ",\n";
+        output << "  \"results\": [";
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+            output << (i == 0 ? "\n" : ",\n");
+            output << "    {\"generator\": \"" << result.generator << "\", \"size\": " << result.size
+                   << ", \"vector_move_ns\": " << result.vectorMoveNanoseconds
+                   << ", \"tour_move_ns\": " << result.tourMoveNanoseconds
+                   << ", \"candidate_lists_s\": " << result.candidateListsSeconds
+                   << ", \"search_s\": " << result.searchSeconds
+                   << ", \"evaluated_moves\": " << result.evaluatedMoves
+                   << ", \"applied_moves\": " << result.appliedMoves
+                   << ", \"evaluated_moves_per_s\": " << perSecond(result.evaluatedMoves, result.searchSeconds)
+                   << ", \"applied_moves_per_s\": " << perSecond(result.appliedMoves, result.searchSeconds)
+                   << ", \"initial_length\": " << result.initialLength
+                   << ", \"final_length\": " << result.finalLength
+                   << ", \"structure_bytes\": " << result.structureBytes
+                   << ", \"peak_rss_bytes\": " << result.peakResidentBytes << "}";
+        }
+
+        output << "\n  ]\n}\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const Options options = parseOptions(argc, argv);
+
+    // Sizes in increasing order: the peak resident size is the one of the whole process, so each run
+    // reports the peak of the largest instance measured so far
+    vector<int> sizes{options.sizes};
+    std::sort(begin(sizes), end(sizes));
+
+    for (auto &generatorName : options.generators)
+        if (generatorName != "random" && generatorName != "clustered")
+            fail("Unknown generator " + generatorName);
+
+    vector<Result> results;
+    for (int size : sizes)
+        for (auto &generatorName : options.generators)
+        {
+            std::cerr << generatorName << " " << size << std::endl;
+            results.push_back(run(generatorName, size, options));
+        }
+
+    if (options.output.empty())
+        writeJson(std::cout, options, results);
+    else
+    {
+        std::ofstream file(options.output);
+        writeJson(file, options, results);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include "../time-utils/TimeUtils.h"
+#include "../time-utils/SeasonKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+/// Benchmark of TimeUtils::getSeason and of SeasonKernels. Every section prints its throughput in millions of records per
+/// second over the same 4M valid dates of both hemispheres, and stops the benchmark when a result is
+/// wrong.
+///
+/// Usage: seasonBenchmark [section...], all the sections by default:
+///        tableAgainstSwitch batchAgainstLoop
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int RECORDS = 1 << 22;
+
+    [[noreturn]] void fail(const string &message)
+    {
+        std::cerr << message << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    void check(bool condition, const string &section)
+    {
+        if (!condition)
+            fail("Wrong result in " + section);
+    }
+
+    /// The dates as columns, as SeasonKernels reads them.
+    struct Records
+    {
+        vector<int> days;
+        vector<int> months;
+        vector<double> latitudes;
+    };
+
+    Records validRecords()
+    {
+        Records records{vector<int>(RECORDS), vector<int>(RECORDS), vector<double>(RECORDS)};
+        for (int i = 0; i < RECORDS; i++)
+        {
+            records.months[i] = 1 + i * 7 % 12;
+            records.days[i] = 1 + i * 13 % TimeUtils::monthDays(records.months[i]);
+            records.latitudes[i] = (i * 31 % 180) - 90.0;
+        }
+
+        return records;
+    }
+
+    double recordsPerSecond(std::chrono::duration<double> elapsed)
+    {
+        return RECORDS / elapsed.count() / 1e6;
+    }
+
+    /// getSeason, which reads the season table, against getSeasonBySwitch.
+    void tableAgainstSwitch()
+    {
+        const Records records = validRecords();
+        auto measure = [&records](auto getSeason)
+        {
+            int summers = 0;
+            const auto start = Clock::now();
+            for (int i = 0; i < RECORDS; i++)
+                summers += getSeason(records.days[i], records.months[i], records.latitudes[i]) == TimeUtils::Season::SUMMER;
+            const double rate = recordsPerSecond(Clock::now() - start);
+            check(summers > 0, "tableAgainstSwitch");
+            return rate;
+        };
+
+        const double switchRate = measure(TimeUtils::getSeasonBySwitch);
+        const double tableRate = measure(TimeUtils::getSeason);
+        std::cout << "millions of records per second - switch: " << switchRate << ", table: " << tableRate << std::endl;
+    }
+
+    /// SeasonKernels::classify, with its scalar kernel and with the one picked at runtime, against a
+    /// getSeason loop, which does not give the validity of the records.
+    void batchAgainstLoop()
+    {
+        const Records records = validRecords();
+        vector<std::uint8_t> seasons(RECORDS);
+        vector<std::uint64_t> validity(SeasonKernels::validityWords(RECORDS));
+
+        auto measure = [](auto classify)
+        {
+            const auto start = Clock::now();
+            const size_t valid = classify();
+            const double rate = recordsPerSecond(Clock::now() - start);
+            check(valid == RECORDS, "batchAgainstLoop");
+            return rate;
+        };
+
+        const double loopRate = measure([&]()
+                                        {
+                                            for (int i = 0; i < RECORDS; i++)
+                                                seasons[i] = TimeUtils::getSeason(records.days[i], records.months[i], records.latitudes[i]);
+                                            return size_t(RECORDS); });
+        const vector<std::uint8_t> expected{seasons};
+        const double scalarRate = measure([&]()
+                                          {
+                                              std::fill(validity.begin(), validity.end(), 0);
+                                              return SeasonKernels::scalar::classify(records.days.data(), records.months.data(), records.latitudes.data(),
+                                                                                     0, RECORDS, seasons.data(), validity.data()); });
+        check(seasons == expected, "batchAgainstLoop");
+        const double batchRate = measure([&]()
+                                         { return SeasonKernels::classify(records.days, records.months, records.latitudes, seasons, validity); });
+        check(seasons == expected, "batchAgainstLoop");
+
+        std::cout << "millions of records per second - getSeason loop: " << loopRate << ", scalar kernel: " << scalarRate
+                  << ", batch" << (SeasonKernels::avx2Supported() ? " (AVX2)" : "") << ": " << batchRate << std::endl;
+    }
+
+    struct Section
+    {
+        string name;
+        void (*run)();
+    };
+
+    const Section sections[] = {
+        {"tableAgainstSwitch", tableAgainstSwitch},
+        {"batchAgainstLoop", batchAgainstLoop},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> selected(argv + 1, argv + argc);
+    for (const string &name : selected)
+        if (std::none_of(std::begin(sections), std::end(sections), [&name](const Section &section)
+                         { return section.name == name; }))
+            fail("Unknown section " + name);
+
+    for (const Section &section : sections)
+        if (selected.empty() || std::find(begin(selected), end(selected), section.name) != end(selected))
+            section.run();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+#include "../string-stack/SimpleStringStack.h"
+#include "../string-stack/ArenaStringStack.h"
+#include "../string-stack/SpillingStringStack.h"
+#include "../string-stack/ConcurrentStringStack.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using std::string;
+using std::vector;
+
+/// Benchmark of the string stacks. Every section prints its rates in millions of push/pop cycles per
+/// second, and stops the benchmark when a stack loses items.
+///
+/// Usage: stringStackBenchmark [section...], all the sections by default:
+///        shortTokens sharedStack spilling
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    [[noreturn]] void fail(const string &message)
+    {
+        std::cerr << message << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    void check(bool condition, const string &section)
+    {
+        if (!condition)
+            fail("Wrong result in " + section);
+    }
+
+    /// 1000 short distinct tokens, pushed in turn.
+    vector<string> tokenInput()
+    {
+        vector<string> input;
+        for (int i = 0; i < 1000; i++)
+            input.push_back("token" + std::to_string(i * 7919 % 100000));
+
+        return input;
+    }
+
+    /// SimpleStringStack against ArenaStringStack, filled with 4M tokens then emptied.
+    void shortTokens()
+    {
+        const int tokens = 1 << 22;
+        const int rounds = 8;
+        const vector<string> input = tokenInput();
+
+        auto measure = [&](auto &stack, auto popAll)
+        {
+            const auto start = Clock::now();
+            for (int round = 0; round < rounds; round++)
+            {
+                for (int i = 0; i < tokens; i++)
+                    stack.push(input[i % input.size()]);
+                popAll(stack);
+            }
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            check(stack.empty(), "shortTokens");
+            return tokens * rounds / elapsed.count() / 1e6;
+        };
+
+        SimpleStringStack simple;
+        ArenaStringStack arena;
+        size_t characters = 0;
+        const double simpleRate = measure(simple, [](SimpleStringStack &stack)
+                                          { while (!stack.empty()) stack.pop(); });
+        const double arenaRate = measure(arena, [&characters](ArenaStringStack &stack)
+                                         { while (!stack.empty()) characters += stack.pop().size(); });
+        check(characters > 0, "shortTokens");
+
+        std::cout << "millions of push/pop cycles per second - SimpleStringStack: " << simpleRate
+                  << ", ArenaStringStack: " << arenaRate << std::endl;
+    }
+
+    /// ConcurrentStringStack against a SimpleStringStack behind a mutex, shared by 1 to 64 threads.
+    void sharedStack()
+    {
+        const int operations = 1 << 18;
+        SimpleStringStack simple;
+        std::mutex mutex;
+        ConcurrentStringStack concurrent;
+
+        // Push/pop cycles per second of <<threadCount>> threads sharing the stack
+        auto measure = [&](int threadCount, bool locked)
+        {
+            const auto start = Clock::now();
+            vector<std::thread> threads;
+            for (int thread = 0; thread < threadCount; thread++)
+                threads.emplace_back([&]()
+                                     {
+                                         string output;
+                                         for (int i = 0; i < operations / threadCount; i++)
+                                             if (locked)
+                                             {
+                                                 {
+                                                     std::lock_guard<std::mutex> lock(mutex);
+                                                     simple.push("token");
+                                                 }
+                                                 std::lock_guard<std::mutex> lock(mutex);
+                                                 output = simple.pop();
+                                             }
+                                             else
+                                             {
+                                                 concurrent.push("token");
+                                                 concurrent.pop(output);
+                                             } });
+            for (std::thread &thread : threads)
+                thread.join();
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            return operations / elapsed.count() / 1e6;
+        };
+
+        for (int threadCount : {1, 2, 4, 8, 16, 32, 64})
+            std::cout << threadCount << " threads - millions of push/pop cycles per second, lock-free: " << measure(threadCount, false)
+                      << ", with a mutex: " << measure(threadCount, true) << std::endl;
+        check(concurrent.empty(), "sharedStack");
+        check(simple.empty(), "sharedStack");
+    }
+
+    /// SpillingStringStack against ArenaStringStack, in memory and 1M items deep with 1 MB in memory.
+    void spilling()
+    {
+        const int tokens = 1 << 22;
+        const vector<string> input = tokenInput();
+
+        // Push/pop cycles per second while the stack is <<depth>> items deep
+        auto measure = [&](auto &stack, int depth)
+        {
+            size_t characters = 0;
+            const auto start = Clock::now();
+            for (int i = 0; i < tokens; i += depth)
+            {
+                for (int j = 0; j < depth; j++)
+                    stack.push(input[j % input.size()]);
+                for (int j = 0; j < depth; j++)
+                    characters += stack.pop().size();
+            }
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            check(stack.empty(), "spilling");
+            check(characters > 0, "spilling");
+            return tokens / elapsed.count() / 1e6;
+        };
+
+        ArenaStringStack arena;
+        SpillingStringStack spillingStack((std::filesystem::temp_directory_path() / "stringStackBenchmark.stack").string(), 1 << 20);
+        std::cout << "millions of push/pop cycles per second in memory - ArenaStringStack: " << measure(arena, 1000)
+                  << ", SpillingStringStack: " << measure(spillingStack, 1000) << std::endl;
+        std::cout << "millions of push/pop cycles per second 1M items deep, 1 MB in memory - SpillingStringStack: "
+                  << measure(spillingStack, 1 << 20) << ", ArenaStringStack: " << measure(arena, 1 << 20) << std::endl;
+    }
+
+    struct Section
+    {
+        string name;
+        void (*run)();
+    };
+
+    const Section sections[] = {
+        {"shortTokens", shortTokens},
+        {"sharedStack", sharedStack},
+        {"spilling", spilling},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> selected(argv + 1, argv + argc);
+    for (const string &name : selected)
+        if (std::none_of(std::begin(sections), std::end(sections), [&name](const Section &section)
+                         { return section.name == name; }))
+            fail("Unknown section " + name);
+
+    for (const Section &section : sections)
+        if (selected.empty() || std::find(begin(selected), end(selected), section.name) != end(selected))
+            section.run();
+
+    return EXIT_SUCCESS;
+}
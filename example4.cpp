@@ -1,101 +1,11 @@
-#include <iostream>
+#include "time-utils/TimeUtils.h"
+#include "time-utils/SeasonKernels.h"
 #include <string>
-#include <exception>
+#include <vector>
+#include <cmath>
+#include <random>
 #include <gtest/gtest.h>
 
-class InvalidDate : public std::exception
-{
-public:
-    InvalidDate(bool invalidDay, bool invalidMonth)
-    {
-        if (invalidDay && invalidMonth)
-            message = "Invalid day and month";
-        else if (!invalidDay)
-            message = "Invalid day";
-        else if (!invalidMonth)
-            message = "Invalid month";
-    }
-
-    virtual const char *what() const throw()
-    {
-        return "Invalid month";
-    }
-
-private:
-    std::string message;
-};
-
-namespace TimeUtils
-{
-    enum Season
-    {
-        SUMMER,
-        WINTER,
-        SPRING,
-        FALL
-    };
-
-    bool isValidMonth(int month)
-    {
-        return month >= 1 && month <= 12;
-    }
-
-    int monthDays(int month)
-    {
-        if (!isValidMonth(month))
-            throw InvalidDate(false, true);
-
-        if (month == 2)
-            return 28;
-        if (month == 4 || month == 6 || month == 9 || month == 11)
-            return 30;
-        else
-            return 31;
-    }
-
-    bool isValidDay(int day, int month)
-    {
-        return day > 0 && day <= monthDays(month);
-    }
-
-    // Does not validate latitude.
-    Season getSeason(int day, int month, double latitude)
-    {
-        bool isInvalidMonth = !isValidMonth(month);
-        bool isInvalidDay = !isValidDay(day, month);
-
-        if (isInvalidMonth || isInvalidDay)
-            throw InvalidDate(isInvalidDay, isInvalidMonth);
-
-        if (month % 3 == 0)
-            month = day < 23 ? month - 1 : (month + 1) % 12;
-
-        switch (month)
-        {
-        case 1:
-        case 2:
-            return latitude > 0 ? Season::WINTER : Season::SUMMER;
-        case 4:
-        case 5:
-            return latitude > 0 ? Season::SPRING : Season::FALL;
-        case 7:
-        case 8:
-            return latitude > 0 ? Season::SUMMER : Season::WINTER;
-        case 10:
-        case 11:
-            return latitude > 0 ? Season::FALL : Season::SPRING;
-        default:
-            // It could be marked [[unlikely]] on C++20
-            throw InvalidDate(isInvalidDay, isInvalidMonth);
-        }
-    }
-
-    bool isSummer(int day, int month, double latitude)
-    {
-        return getSeason(day, month, latitude) == Season::SUMMER;
-    }
-}
-
 TEST(PredicateTests, ValidMonths)
 {
     EXPECT_PRED1(TimeUtils::isValidMonth, 1);
@@ -153,4 +63,89 @@ TEST(AssertTests, IsNotSummer)
     ASSERT_FALSE(TimeUtils::isSummer(24, 7, -30));
     ASSERT_FALSE(TimeUtils::isSummer(24, 8, -30));
     ASSERT_FALSE(TimeUtils::isSummer(4, 9, -30));
-}
\ No newline at end of file
+}
+
+TEST(SeasonTableTests, MatchesSwitchForEveryDate)
+{
+    // Every date around the valid ones, in both hemispheres, on the equator and for a NaN latitude
+    for (double latitude : {-10.0, -0.0, 0.0, 0.5, 30.0, std::nan("")})
+        for (int month = -2; month <= 15; month++)
+            for (int day = -2; day <= 40; day++)
+            {
+                bool switchThrows = false;
+                TimeUtils::Season expected{};
+                try
+                {
+                    expected = TimeUtils::getSeasonBySwitch(day, month, latitude);
+                }
+                catch (const InvalidDate &)
+                {
+                    switchThrows = true;
+                }
+
+                if (switchThrows)
+                    ASSERT_THROW(TimeUtils::getSeason(day, month, latitude), InvalidDate) << day << "/" << month;
+                else
+                    ASSERT_EQ(TimeUtils::getSeason(day, month, latitude), expected) << day << "/" << month;
+            }
+
+    ASSERT_THROW(TimeUtils::getSeason(1, 1 << 30, 10), InvalidDate);
+    ASSERT_THROW(TimeUtils::getSeason(-(1 << 30), 1, 10), InvalidDate);
+    static_assert(TimeUtils::SeasonTable::entries[TimeUtils::SeasonTable::index(true, 12, 23)] == TimeUtils::Season::WINTER);
+}
+
+TEST(SeasonKernelsTests, MatchesGetSeasonForEveryRecord)
+{
+    // Mostly valid dates, and some out of range in every way, or only valid dates, which the scalar
+    // kernel checks a word at a time; sizes not multiple of 8 leave a tail
+    std::mt19937 random(4);
+    const size_t sizes[] = {0, 1, 7, 8, 9, 64, 65, 1000};
+    for (size_t test = 0; test < 16; test++)
+    {
+        const size_t records = sizes[test % 8];
+        const bool onlyValid = test >= 8;
+        std::vector<int> days(records), months(records);
+        std::vector<double> latitudes(records);
+        const int extremes[] = {-1, 0, 13, 32, 1 << 30, -(1 << 30), 31, 29};
+        for (size_t i = 0; i < records; i++)
+        {
+            days[i] = random() % 5 == 0 ? extremes[random() % 8] : 1 + random() % 31;
+            months[i] = random() % 7 == 0 ? extremes[random() % 8] : 1 + random() % 12;
+            if (onlyValid)
+            {
+                days[i] = 1 + random() % 28;
+                months[i] = 1 + random() % 12;
+            }
+            latitudes[i] = random() % 11 == 0 ? std::nan("") : static_cast<double>(random() % 181) - 90;
+        }
+
+        std::vector<std::uint8_t> seasons(records), scalarSeasons(records);
+        std::vector<std::uint64_t> validity(SeasonKernels::validityWords(records)), scalarValidity(validity.size());
+        const size_t valid = SeasonKernels::classify(days, months, latitudes, seasons, validity);
+        EXPECT_EQ(SeasonKernels::scalar::classify(days.data(), months.data(), latitudes.data(), 0, records,
+                                                  scalarSeasons.data(), scalarValidity.data()),
+                  valid);
+        EXPECT_EQ(seasons, scalarSeasons);
+        EXPECT_EQ(validity, scalarValidity);
+
+        size_t expectedValid = 0;
+        for (size_t i = 0; i < records; i++)
+        {
+            const bool isValid = TimeUtils::isValidMonth(months[i]) && TimeUtils::isValidDay(days[i], months[i]);
+            ASSERT_EQ(SeasonKernels::isValid(validity, i), isValid) << days[i] << "/" << months[i];
+            if (isValid)
+                ASSERT_EQ(seasons[i], TimeUtils::getSeason(days[i], months[i], latitudes[i])) << days[i] << "/" << months[i];
+            else
+                ASSERT_EQ(seasons[i], 0);
+            expectedValid += isValid;
+        }
+        EXPECT_EQ(valid, expectedValid);
+    }
+
+    std::vector<int> three(3);
+    std::vector<double> latitudes(3);
+    std::vector<std::uint8_t> seasons(3);
+    std::vector<std::uint64_t> validity(1);
+    EXPECT_THROW(SeasonKernels::classify(three, std::vector<int>(2), latitudes, seasons, validity), BatchSizeMismatchException);
+    EXPECT_THROW(SeasonKernels::classify(three, three, latitudes, seasons, std::span<std::uint64_t>()), BatchSizeMismatchException);
+}
@@ -1,53 +1,66 @@
-#include <iostream>
+#include "string-stack/SimpleStringStack.h"
+#include "string-stack/ArenaStringStack.h"
+#include "string-stack/ConcurrentStringStack.h"
+#include "string-stack/SpillingStringStack.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <algorithm>
+#include <thread>
 #include <exception>
+#include <filesystem>
 #include <gtest/gtest.h>
 using std::string;
+using std::string_view;
 using std::vector;
 
-class SimpleStringStack
+class SimpleStringStackTest : public testing::Test
 {
-
-public:
-    SimpleStringStack() = default;
-    void push(const string newValue)
-    {
-        stack.push_back(newValue);
-    };
-
-    /// It is not really a pop, neither a top as defined in std::stack type.
-    string pop()
+protected:
+    void SetUp() override
     {
-        if (empty())
-            return "";
-
-        string top = stack[stack.size() - 1];
-        stack.erase(stack.end() - 1);
-
-        return top;
+        stack.push("first");
+        stack.push("second");
+        stack.push("third");
     };
 
-    void clear()
+    void TearDown() override
     {
         stack.clear();
     }
 
-    bool empty()
-    {
-        return stack.empty();
-    }
+    SimpleStringStack stack;
+};
 
-    int count()
-    {
-        return stack.size();
-    }
+TEST_F(SimpleStringStackTest, testPop)
+{
+    EXPECT_EQ(stack.count(), 3);
+    EXPECT_EQ(stack.pop(), "third");
+    EXPECT_EQ(stack.count(), 2);
+    EXPECT_EQ(stack.pop(), "second");
+    EXPECT_EQ(stack.count(), 1);
+    EXPECT_EQ(stack.pop(), "first");
+    EXPECT_EQ(stack.count(), 0);
+    ASSERT_TRUE(stack.empty());
+}
 
-private:
-    vector<string> stack;
-};
+TEST_F(SimpleStringStackTest, testPush)
+{
+    EXPECT_EQ(stack.count(), 3);
+    stack.push("fourth");
+    EXPECT_EQ(stack.count(), 4);
 
-class SimpleStringStackTest : public testing::Test
+    stack.pop();
+    stack.pop();
+    stack.pop();
+    stack.pop();
+    ASSERT_TRUE(stack.empty());
+
+    stack.push("some");
+    ASSERT_FALSE(stack.empty());
+}
+
+class ArenaStringStackTest : public testing::Test
 {
 protected:
     void SetUp() override
@@ -62,10 +75,10 @@ protected:
         stack.clear();
     }
 
-    SimpleStringStack stack;
+    ArenaStringStack stack;
 };
 
-TEST_F(SimpleStringStackTest, testPop)
+TEST_F(ArenaStringStackTest, testPop)
 {
     EXPECT_EQ(stack.count(), 3);
     EXPECT_EQ(stack.pop(), "third");
@@ -75,20 +88,244 @@ TEST_F(SimpleStringStackTest, testPop)
     EXPECT_EQ(stack.pop(), "first");
     EXPECT_EQ(stack.count(), 0);
     ASSERT_TRUE(stack.empty());
+    EXPECT_EQ(stack.pop(), "");
 }
 
-TEST_F(SimpleStringStackTest, testPush)
+TEST_F(ArenaStringStackTest, testPush)
 {
     EXPECT_EQ(stack.count(), 3);
     stack.push("fourth");
-    EXPECT_EQ(stack.count(), 4);
+    stack.push("");
+    EXPECT_EQ(stack.count(), 5);
+    EXPECT_EQ(stack.top(), "");
 
+    // A popped view stays valid until the next change
     stack.pop();
-    stack.pop();
+    string_view fourth = stack.pop();
+    EXPECT_EQ(stack.top(), "third");
+    EXPECT_EQ(fourth, "fourth");
+
+    // ...and can be pushed back, even when the arena grows
+    stack.push(fourth);
+    stack.push(stack.top());
+    EXPECT_EQ(stack.pop(), "fourth");
+    EXPECT_EQ(stack.pop(), "fourth");
+
+    string output;
+    ASSERT_TRUE(stack.pop(output));
+    EXPECT_EQ(output, "third");
     stack.pop();
     stack.pop();
     ASSERT_TRUE(stack.empty());
+    ASSERT_FALSE(stack.pop(output));
 
     stack.push("some");
     ASSERT_FALSE(stack.empty());
 }
+
+TEST_F(ArenaStringStackTest, testBulkPushPopAndClear)
+{
+    stack.pushAll(vector<string>{"a", "bc", "def"});
+    stack.pushAll(vector<const char *>{"gh"});
+    EXPECT_EQ(stack.count(), 7);
+
+    vector<string_view> popped(5);
+    EXPECT_EQ(stack.pop(span<string_view>(popped)), 5);
+    EXPECT_EQ(popped, vector<string_view>({"gh", "def", "bc", "a", "third"}));
+    EXPECT_EQ(stack.count(), 2);
+    EXPECT_EQ(stack.pop(span<string_view>(popped)), 2);
+    EXPECT_EQ(popped[1], "first");
+    ASSERT_TRUE(stack.empty());
+
+    // The arena keeps its memory after clear
+    stack.pushAll(vector<string>(100, "token"));
+    const size_t capacity = stack.arenaCapacity();
+    stack.clear();
+    ASSERT_TRUE(stack.empty());
+    EXPECT_EQ(stack.arenaCapacity(), capacity);
+}
+
+TEST(ConcurrentStringStackTest, testPushPopAndCount)
+{
+    ConcurrentStringStack stack;
+    stack.push("first");
+    stack.push("second");
+    stack.push("third");
+    EXPECT_EQ(stack.count(), 3);
+    EXPECT_EQ(stack.pop(), "third");
+    EXPECT_EQ(stack.pop(), "second");
+    EXPECT_EQ(stack.count(), 1);
+
+    string output;
+    ASSERT_TRUE(stack.pop(output));
+    EXPECT_EQ(output, "first");
+    ASSERT_TRUE(stack.empty());
+    ASSERT_FALSE(stack.pop(output));
+    EXPECT_EQ(stack.pop(), "");
+
+    stack.push("some");
+    stack.push("more");
+    stack.clear();
+    ASSERT_TRUE(stack.empty());
+    EXPECT_EQ(stack.count(), 0);
+}
+
+TEST(ConcurrentStringStackTest, stressEveryItemPoppedOnce)
+{
+    const int threadCount = 8;
+    const int pushesPerThread = 20000;
+    ConcurrentStringStack stack;
+    vector<vector<string>> popped(threadCount);
+
+    vector<std::thread> threads;
+    for (int thread = 0; thread < threadCount; thread++)
+        threads.emplace_back([&, thread]()
+                             {
+                                 string output;
+                                 for (int i = 0; i < pushesPerThread; i++)
+                                 {
+                                     stack.push(std::to_string(thread) + "-" + std::to_string(i));
+                                     // Pop one item for every two pushes, so that the stack grows and shrinks
+                                     if (i % 2 == 1 && stack.pop(output))
+                                         popped[thread].push_back(output);
+                                 } });
+    for (std::thread &thread : threads)
+        thread.join();
+
+    vector<string> all;
+    for (auto &items : popped)
+        all.insert(all.end(), items.begin(), items.end());
+    EXPECT_EQ(stack.count() + all.size(), threadCount * pushesPerThread);
+
+    string output;
+    while (stack.pop(output))
+        all.push_back(output);
+    EXPECT_EQ(stack.count(), 0);
+
+    // Nothing lost, nothing popped twice
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+    EXPECT_EQ(all.size(), threadCount * pushesPerThread);
+}
+
+static string spillPath(const string &name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TEST(SpillingStringStackTest, testMatchesVectorAcrossSpills)
+{
+    const string path = spillPath("example5-spill.stack");
+    vector<string> expected;
+    {
+        SpillingStringStack stack(path, 4096);
+        for (int i = 0; i < 100000; i++)
+        {
+            // Mostly pushes, with pops reaching into the file from time to time
+            if (i % 1000 == 999)
+                for (int j = 0; j < 300; j++)
+                {
+                    ASSERT_EQ(stack.pop(), expected.back());
+                    expected.pop_back();
+                }
+            expected.push_back("item" + std::to_string(i) + string(i % 13, 'x'));
+            stack.push(expected.back());
+            ASSERT_LE(stack.memoryBytes(), 4096u);
+        }
+
+        EXPECT_EQ(stack.count(), expected.size());
+        EXPECT_GT(stack.spilled(), 0u);
+        EXPECT_TRUE(std::filesystem::exists(path));
+        string output;
+        while (!expected.empty())
+        {
+            ASSERT_TRUE(stack.pop(output));
+            ASSERT_EQ(output, expected.back());
+            expected.pop_back();
+        }
+        EXPECT_TRUE(stack.empty());
+        EXPECT_FALSE(stack.pop(output));
+        EXPECT_EQ(stack.pop(), "");
+    }
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(SpillingStringStackTest, testPushBackTheLastItemOfASegment)
+{
+    const string path = spillPath("example5-push-back.stack");
+    SpillingStringStack stack(path, 1024);
+    for (int i = 0; i < 1000; i++)
+        stack.push("item" + std::to_string(i));
+    EXPECT_GT(stack.spilled(), 0u);
+
+    // The bottom item empties the first segment: its view must be copied before the file shrinks
+    while (stack.count() > 1)
+        stack.pop();
+    const string_view bottom = stack.pop();
+    stack.push(bottom);
+    EXPECT_EQ(stack.count(), 1u);
+    EXPECT_EQ(stack.spilled(), 0u);
+    EXPECT_EQ(std::filesystem::file_size(path), static_cast<std::uintmax_t>(sysconf(_SC_PAGESIZE)));
+    EXPECT_EQ(stack.pop(), "item0");
+}
+
+TEST(SpillingStringStackTest, testReopenAndClear)
+{
+    const string path = spillPath("example5-reopen.stack");
+    std::filesystem::remove(path);
+    {
+        SpillingStringStack stack(path, 1024, KEEP_ON_CLOSE);
+        for (int i = 0; i < 1000; i++)
+            stack.push(std::to_string(i));
+        EXPECT_EQ(stack.pop(), "999");
+    }
+    {
+        // Restored after a restart, the items in memory included
+        SpillingStringStack stack(path, 1024, KEEP_ON_CLOSE);
+        EXPECT_EQ(stack.count(), 999u);
+        EXPECT_EQ(stack.spilled(), 999u);
+        for (int i = 998; i >= 500; i--)
+            ASSERT_EQ(stack.pop(), std::to_string(i));
+        stack.push("top");
+    }
+    {
+        SpillingStringStack stack(path, 1024, KEEP_ON_CLOSE);
+        EXPECT_EQ(stack.count(), 501u);
+        EXPECT_EQ(stack.pop(), "top");
+        EXPECT_EQ(stack.pop(), "499");
+        stack.clear();
+        EXPECT_TRUE(stack.empty());
+        EXPECT_EQ(std::filesystem::file_size(path), static_cast<std::uintmax_t>(sysconf(_SC_PAGESIZE)));
+        stack.push("again");
+        EXPECT_EQ(stack.pop(), "again");
+    }
+    std::filesystem::remove(path);
+
+    std::filesystem::create_directories(spillPath("example5-not-a-stack"));
+    EXPECT_THROW(SpillingStringStack(spillPath("example5-not-a-stack"), 1024), SpillFileException);
+    std::filesystem::remove(spillPath("example5-not-a-stack"));
+}
+
+TEST(SpillingStringStackTest, testTruncatedFile)
+{
+    const string path = spillPath("example5-truncated.stack");
+    std::filesystem::remove(path);
+    {
+        SpillingStringStack stack(path, 1024, KEEP_ON_CLOSE);
+        for (int i = 0; i < 1000; i++)
+            stack.push(std::to_string(i));
+        stack.flush();
+        EXPECT_EQ(stack.spilled(), 1000u);
+        EXPECT_EQ(stack.pop(), "999");
+    }
+
+    // The last segment is cut: reopening fails instead of mapping past the end of the file, and
+    // does not leave the file open
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - sysconf(_SC_PAGESIZE) / 2);
+    const auto openFiles = []()
+    { return std::distance(std::filesystem::directory_iterator("/proc/self/fd"), std::filesystem::directory_iterator()); };
+    const auto filesBefore = openFiles();
+    EXPECT_THROW(SpillingStringStack(path, 1024, KEEP_ON_CLOSE), SpillFileException);
+    EXPECT_EQ(openFiles(), filesBefore);
+    std::filesystem::remove(path);
+}
@@ -1,77 +1,19 @@
-#include <vector>
-#include <exception>
-#include <algorithm>
-using std::begin;
-using std::exception;
-using std::reverse;
-using std::vector;
+#include "routing/TwoOpt.h"
+#include "routing/TwoOptSearch.h"
+#include "routing/ReversibleTour.h"
+#include "routing/MultiStartTwoOpt.h"
+#include "routing/ThreeOpt.h"
+#include "routing/DontLookBitsSearch.h"
+#include "routing/DistanceOracle.h"
+#include "routing/NeighbourLists.h"
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
 #include <gtest/gtest.h>
 
-class InvalidFirstIndexException : public exception
-{
-    virtual const char *what() const throw()
-    {
-        return "Invalid first index exception. This index must reference an element before both the modified interval (that has minimum size 2) and the second index";
-    }
-};
-
-class InvalidSecondIndexException : public exception
-{
-    virtual const char *what() const throw()
-    {
-        return "Invalid second index exception. This index must reference an element after both the modified interval (that has minimum size 2) and the first index";
-    }
-};
-
-class TooShortRouteException : public exception
-{
-    virtual const char *what() const throw()
-    {
-        return "The route must have a size greater than 3 to apply a two-opt.";
-    }
-};
-
-class TooShortTwoOptRangeException : public exception
-{
-    virtual const char *what() const throw()
-    {
-        return "The two opt range must have a minimum size greater than one.";
-    }
-};
-
-void twoOpt(vector<int> &route, int firstIndex, int secondIndex)
-{
-    /**
-     * This function alters the route R, inverting the subsequence delimited by <<firstIndex>> and
-     * <<secondIndex>>. After this invertion the element referenced by <<firstIndex>> will be succeded
-     * by the one that preceeds that referenced by <<secondIndex>>, and element referenced by
-     * <<secondIndex>> will be preceeded by the one the succeded the one referenced by <<firstIndex>>.
-     * Ex:
-     *    Original route R = A -- B -- C -- D -- E -- F, firstIndex = 1, secondIndex = 4
-     *                        firstIndex    secondIndex
-     *    Final route    R = A -- B -- D -- C -- E -- F
-     */
-
-    if (secondIndex < firstIndex)
-        std::swap(secondIndex, firstIndex);
-
-    // Out of range exceptions will not be managed here
-
-    if (route.size() < 4)
-        throw TooShortRouteException();
-
-    if (firstIndex >= route.size() - 2)
-        throw InvalidFirstIndexException();
-    if (secondIndex < 3)
-        throw InvalidSecondIndexException();
-
-    // It must have at least two elements between the two-opt extremities
-    if (secondIndex <= firstIndex + 2)
-        throw TooShortTwoOptRangeException();
-
-    std::reverse(begin(route) + firstIndex + 1, begin(route) + secondIndex);
-}
-
 TEST(TwoOptTests, tooShortRoute)
 {
     vector<int> route{1, 2, 3};
@@ -154,4 +96,637 @@ TEST(TwoOptTests, largeTwoOptOddRange)
     EXPECT_EQ(route[4], control[7]);
     EXPECT_EQ(route[5], control[6]);
     EXPECT_EQ(route[9], control[9]);
-}
\ No newline at end of file
+}
+namespace
+{
+    vector<vector<double>> squareDistances(const vector<double> &xs, const vector<double> &ys)
+    {
+        vector<vector<double>> distances(xs.size(), vector<double>(xs.size()));
+        for (int from = 0; from < static_cast<int>(xs.size()); from++)
+            for (int to = 0; to < static_cast<int>(xs.size()); to++)
+                distances[from][to] = std::hypot(xs[from] - xs[to], ys[from] - ys[to]);
+
+        return distances;
+    }
+
+    template <class Distance>
+    double routeLength(const vector<int> &route, const Distance &distance)
+    {
+        double length{};
+        for (int i = 0; i + 1 < static_cast<int>(route.size()); i++)
+            length += distance(route[i], route[i + 1]);
+
+        return length;
+    }
+
+    DistanceMatrix randomDistances(int size, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> coordinate(0, 1000);
+        vector<double> xs(size), ys(size);
+        for (int i = 0; i < size; i++)
+        {
+            xs[i] = coordinate(generator);
+            ys[i] = coordinate(generator);
+        }
+
+        return DistanceMatrix(squareDistances(xs, ys));
+    }
+
+    vector<int> identityRoute(int size)
+    {
+        vector<int> route(size);
+        std::iota(begin(route), end(route), 0);
+        return route;
+    }
+}
+
+TEST(TwoOptSearchTests, moveGainMatchesRouteLengthDifference)
+{
+    DistanceMatrix distances = randomDistances(12, 7);
+    TwoOptSearch search(distances);
+    const vector<int> route = identityRoute(12);
+
+    for (int firstIndex = 0; firstIndex + 3 < static_cast<int>(route.size()); firstIndex++)
+        for (int secondIndex = firstIndex + 3; secondIndex < static_cast<int>(route.size()); secondIndex++)
+        {
+            vector<int> moved{route};
+            twoOpt(moved, firstIndex, secondIndex);
+            EXPECT_NEAR(search.moveGain(route, firstIndex, secondIndex),
+                        routeLength(route, distances) - routeLength(moved, distances), 1e-9);
+        }
+}
+
+TEST(TwoOptSearchTests, uncrossesSquareRoute)
+{
+    // A -- C -- B -- D visits the square corners crossing its diagonals.
+    DistanceMatrix distances(squareDistances({0, 1, 0, 1}, {0, 0, 1, 1}));
+    TwoOptSearch search(distances, BEST_IMPROVEMENT);
+    vector<int> route{0, 3, 1, 2};
+
+    EXPECT_EQ(search.optimize(route), 1);
+    EXPECT_EQ(route, (vector<int>{0, 1, 3, 2}));
+    EXPECT_FALSE(search.findImprovingMove(route).isImproving());
+}
+
+TEST(TwoOptSearchTests, reachesLocalOptimumInBothModes)
+{
+    DistanceMatrix distances = randomDistances(60, 42);
+
+    for (auto mode : {FIRST_IMPROVEMENT, BEST_IMPROVEMENT})
+    {
+        TwoOptSearch search(distances, mode);
+        vector<int> route = identityRoute(60);
+        const double initialLength = routeLength(route, distances);
+
+        EXPECT_GT(search.optimize(route), 0);
+        EXPECT_LT(routeLength(route, distances), initialLength);
+        EXPECT_FALSE(search.findImprovingMove(route).isImproving());
+        EXPECT_EQ(route.front(), 0);
+        EXPECT_EQ(route.back(), 59);
+
+        vector<int> sorted{route};
+        std::sort(begin(sorted), end(sorted));
+        EXPECT_EQ(sorted, identityRoute(60));
+    }
+}
+
+TEST(TwoOptSearchTests, acceptsDistanceCallback)
+{
+    DistanceMatrix matrix = randomDistances(30, 3);
+    std::function<double(int, int)> callback = [&matrix](int from, int to)
+    { return matrix(from, to); };
+
+    TwoOptSearch matrixSearch(matrix);
+    TwoOptSearch callbackSearch(callback);
+    vector<int> matrixRoute = identityRoute(30);
+    vector<int> callbackRoute = identityRoute(30);
+
+    EXPECT_EQ(matrixSearch.optimize(matrixRoute), callbackSearch.optimize(callbackRoute));
+    EXPECT_EQ(matrixRoute, callbackRoute);
+    EXPECT_EQ(matrixSearch.evaluatedMoves(), callbackSearch.evaluatedMoves());
+}
+
+TEST(ReversibleTourTests, keepsTwoOptExceptions)
+{
+    ReversibleTour shortRoute(vector<int>{1, 2, 3});
+    ReversibleTour route(vector<int>{1, 2, 3, 4, 5});
+
+    EXPECT_THROW(twoOpt(shortRoute, 1, 3), TooShortRouteException);
+    EXPECT_THROW(twoOpt(route, 1, 3), TooShortTwoOptRangeException);
+    EXPECT_THROW(twoOpt(route, 3, 4), InvalidFirstIndexException);
+    EXPECT_THROW(twoOpt(route, 1, 2), InvalidSecondIndexException);
+    EXPECT_THROW(ReversibleTour(vector<int>{1, 2, 2}), InvalidTourException);
+    EXPECT_THROW(ReversibleTour(vector<int>{1, -2, 3}), InvalidTourException);
+}
+
+TEST(ReversibleTourTests, matchesVectorTwoOpt)
+{
+    vector<int> route{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    ReversibleTour tour(route);
+
+    twoOpt(route, 2, 8);
+    twoOpt(tour, 2, 8);
+    EXPECT_EQ(tour.toVector(), route);
+
+    twoOpt(route, 9, 0);
+    twoOpt(tour, 9, 0);
+    EXPECT_EQ(tour.toVector(), route);
+}
+
+TEST(ReversibleTourTests, randomMovesAndQueries)
+{
+    const int size = 200;
+    vector<int> route = identityRoute(size);
+    ReversibleTour tour(route);
+    std::mt19937 generator(11);
+
+    for (int move = 0; move < 500; move++)
+    {
+        int firstIndex = generator() % (size - 3);
+        int secondIndex = firstIndex + 3 + generator() % (size - firstIndex - 3);
+        twoOpt(route, firstIndex, secondIndex);
+        twoOpt(tour, firstIndex, secondIndex);
+
+        const int position = generator() % size;
+        const int element = route[position];
+        ASSERT_EQ(tour[position], element);
+        ASSERT_EQ(tour.positionOf(element), position);
+        ASSERT_EQ(tour.next(element), position + 1 < size ? route[position + 1] : -1);
+        ASSERT_EQ(tour.prev(element), position > 0 ? route[position - 1] : -1);
+    }
+
+    EXPECT_EQ(tour.toVector(), route);
+    EXPECT_TRUE(tour.between(route[10], route[20], route[30]));
+    EXPECT_FALSE(tour.between(route[10], route[40], route[30]));
+    EXPECT_TRUE(tour.between(route[150], route[5], route[30]));
+}
+
+TEST(ReversibleTourTests, usableByTwoOptSearch)
+{
+    DistanceMatrix distances = randomDistances(40, 5);
+    TwoOptSearch vectorSearch(distances);
+    TwoOptSearch tourSearch(distances);
+    vector<int> route = identityRoute(40);
+    ReversibleTour tour(route);
+
+    EXPECT_EQ(vectorSearch.optimize(route), tourSearch.optimize(tour));
+    EXPECT_EQ(tour.toVector(), route);
+}
+
+TEST(TwoOptKernelTests, batchGainsMatchMoveGain)
+{
+    DistanceMatrix distances = randomDistances(100, 13);
+    TwoOptSearch search(distances);
+    vector<int> route = identityRoute(100);
+    std::shuffle(begin(route), end(route), std::mt19937(1));
+
+    std::mt19937 generator(2);
+    vector<int> firstIndices, secondIndices;
+    for (int k = 0; k < 203; k++)
+    {
+        firstIndices.push_back(generator() % 97);
+        secondIndices.push_back(firstIndices.back() + 3 + generator() % (97 - firstIndices.back()));
+    }
+
+    vector<double> gains(firstIndices.size());
+    TwoOptKernels::evaluateGains(route, distances, firstIndices, secondIndices, gains);
+    for (size_t k = 0; k < gains.size(); k++)
+        EXPECT_EQ(gains[k], search.moveGain(route, firstIndices[k], secondIndices[k]));
+
+    TwoOptMove best = TwoOptKernels::findBestMove(route, distances, firstIndices, secondIndices);
+    ASSERT_TRUE(best.isImproving());
+    EXPECT_EQ(best.gain, *std::max_element(begin(gains), end(gains)));
+    EXPECT_NO_THROW(twoOpt(route, best.firstIndex, best.secondIndex));
+}
+
+TEST(TwoOptKernelTests, bestMoveMatchesScalarScan)
+{
+    DistanceMatrix distances = randomDistances(157, 17);
+    auto callback = [&distances](int from, int to)
+    { return distances(from, to); };
+    TwoOptSearch scalarSearch(callback, BEST_IMPROVEMENT);
+    vector<int> route = identityRoute(157);
+
+    for (int move = 0; move < 20; move++)
+    {
+        TwoOptMove expected = scalarSearch.findImprovingMove(route);
+        TwoOptMove best = TwoOptKernels::findBestMove(route, distances);
+
+        EXPECT_EQ(best.firstIndex, expected.firstIndex);
+        EXPECT_EQ(best.secondIndex, expected.secondIndex);
+        EXPECT_EQ(best.gain, expected.gain);
+        if (!best.isImproving())
+            break;
+        twoOpt(route, best.firstIndex, best.secondIndex);
+    }
+
+    // Every remainder of the blocks of 8 and 4 candidates
+    for (int size = 4; size <= 24; size++)
+    {
+        vector<int> shuffled = identityRoute(size);
+        std::shuffle(begin(shuffled), end(shuffled), std::mt19937(size));
+        TwoOptMove expected = scalarSearch.findImprovingMove(shuffled);
+        TwoOptMove best = TwoOptKernels::findBestMove(shuffled, distances);
+        EXPECT_EQ(best.firstIndex, expected.firstIndex) << size;
+        EXPECT_EQ(best.secondIndex, expected.secondIndex) << size;
+        EXPECT_EQ(best.gain, expected.gain) << size;
+    }
+}
+
+// Not a correctness test: prints the speedup of the batch kernel over the scalar scan of TwoOptSearch.
+TEST(TwoOptKernelTests, benchmarkBestMove)
+{
+    if (!TwoOptKernels::avx2Supported())
+        GTEST_SKIP() << "AVX2 is not supported by this processor";
+
+    const int size = 3000;
+    const int repetitions = 5;
+    DistanceMatrix distances = randomDistances(size, 19);
+    auto callback = [&distances](int from, int to)
+    { return distances(from, to); };
+    TwoOptSearch scalarSearch(callback, BEST_IMPROVEMENT);
+    vector<int> route = identityRoute(size);
+    std::shuffle(begin(route) + 1, end(route) - 1, std::mt19937(3));
+
+    auto measure = [repetitions](auto scan)
+    {
+        TwoOptMove move{};
+        auto start = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < repetitions; repetition++)
+            move = scan();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(move, elapsed.count() / repetitions);
+    };
+
+    auto [scalarMove, scalarTime] = measure([&]
+                                            { return scalarSearch.findImprovingMove(route); });
+    auto [kernelMove, kernelTime] = measure([&]
+                                            { return TwoOptKernels::findBestMove(route, distances); });
+
+    EXPECT_EQ(kernelMove.firstIndex, scalarMove.firstIndex);
+    EXPECT_EQ(kernelMove.secondIndex, scalarMove.secondIndex);
+    EXPECT_EQ(kernelMove.gain, scalarMove.gain);
+    std::cout << "scalar scan: " << scalarTime * 1e3 << " ms, batch kernel: " << kernelTime * 1e3
+              << " ms, speedup: " << scalarTime / kernelTime << "x" << std::endl;
+}
+
+TEST(WorkStealingPoolTests, runsEveryTaskOnce)
+{
+    WorkStealingPool pool(4);
+    vector<int> calls(1000);
+
+    for (int batch = 0; batch < 3; batch++)
+        pool.run(calls.size(), [&calls, &pool](size_t index, int worker)
+                 {
+                     EXPECT_GE(worker, 0);
+                     EXPECT_LT(worker, pool.size());
+                     calls[index]++; });
+
+    EXPECT_EQ(std::count(begin(calls), end(calls), 3), calls.size());
+    EXPECT_THROW(pool.run(10, [](size_t index, int)
+                          { if (index == 7) throw TooShortRouteException(); }),
+                 TooShortRouteException);
+}
+
+TEST(MultiStartTwoOptTests, deterministicForSeed)
+{
+    DistanceMatrix distances = randomDistances(80, 23);
+    vector<vector<int>> routes;
+    for (int route = 0; route < 6; route++)
+    {
+        routes.push_back(identityRoute(80));
+        std::shuffle(begin(routes.back()), end(routes.back()), std::mt19937(route));
+    }
+
+    MultiStartTwoOpt singleThread(distances, 5, 99, FIRST_IMPROVEMENT, 1);
+    MultiStartTwoOpt multiThread(distances, 5, 99, FIRST_IMPROVEMENT, 4);
+    vector<vector<int>> expected = singleThread.optimize(routes);
+
+    EXPECT_EQ(multiThread.optimize(routes), expected);
+    EXPECT_EQ(multiThread.optimize(routes), expected);
+
+    TwoOptSearch search(distances);
+    for (int route = 0; route < static_cast<int>(routes.size()); route++)
+    {
+        vector<int> singleStart{routes[route]};
+        search.optimize(singleStart);
+
+        EXPECT_EQ(expected[route].front(), routes[route].front());
+        EXPECT_EQ(expected[route].back(), routes[route].back());
+        EXPECT_FALSE(search.findImprovingMove(expected[route]).isImproving());
+        EXPECT_LE(search.length(expected[route]), search.length(singleStart));
+    }
+}
+
+TEST(ThreeOptTests, validation)
+{
+    vector<int> shortRoute{1, 2, 3};
+    vector<int> route{1, 2, 3, 4, 5, 6};
+
+    EXPECT_THROW(threeOpt(shortRoute, 0, 1, 2, SWAP_SEGMENTS), TooShortRouteException);
+    EXPECT_THROW(threeOpt(route, 2, 2, 5, SWAP_SEGMENTS), InvalidFirstIndexException);
+    EXPECT_THROW(threeOpt(route, 0, 4, 5, SWAP_SEGMENTS), InvalidSecondIndexException);
+    EXPECT_THROW(threeOpt(route, 0, 2, 6, SWAP_SEGMENTS), InvalidThirdIndexException);
+
+    EXPECT_THROW(orOpt(route, 1, 4, 5), InvalidSegmentLengthException);
+    EXPECT_THROW(orOpt(shortRoute, 1, 1, 2), TooShortRouteException);
+    EXPECT_THROW(orOpt(route, 0, 1, 3), InvalidFirstIndexException);
+    EXPECT_THROW(orOpt(route, 4, 2, 1), InvalidFirstIndexException);
+    EXPECT_THROW(orOpt(route, 2, 2, 3), InvalidSecondIndexException);
+    EXPECT_THROW(orOpt(route, 2, 2, 5), InvalidSecondIndexException);
+}
+
+TEST(ThreeOptTests, reconnections)
+{
+    const vector<int> route{0, 1, 2, 3, 4, 5};
+    auto moved = [&route](ThreeOptReconnection reconnection)
+    {
+        vector<int> result{route};
+        threeOpt(result, 0, 2, 5, reconnection);
+        return result;
+    };
+
+    EXPECT_EQ(moved(SWAP_SEGMENTS), (vector<int>{0, 3, 4, 1, 2, 5}));
+    EXPECT_EQ(moved(SWAP_REVERSE_FIRST), (vector<int>{0, 3, 4, 2, 1, 5}));
+    EXPECT_EQ(moved(SWAP_REVERSE_SECOND), (vector<int>{0, 4, 3, 1, 2, 5}));
+    EXPECT_EQ(moved(REVERSE_BOTH), (vector<int>{0, 2, 1, 4, 3, 5}));
+}
+
+TEST(ThreeOptTests, orOptInBothDirections)
+{
+    vector<int> forward{0, 1, 2, 3, 4, 5};
+    orOpt(forward, 1, 2, 4);
+    EXPECT_EQ(forward, (vector<int>{0, 3, 4, 1, 2, 5}));
+
+    vector<int> backward{0, 1, 2, 3, 4, 5};
+    orOpt(backward, 3, 2, 0, true);
+    EXPECT_EQ(backward, (vector<int>{0, 4, 3, 1, 2, 5}));
+}
+
+TEST(DontLookBitsSearchTests, betterToursThanTwoOpt)
+{
+    double twoOptLength{}, dontLookLength{};
+
+    for (unsigned seed = 0; seed < 5; seed++)
+    {
+        DistanceMatrix distances = randomDistances(300, seed);
+        vector<int> initial = identityRoute(300);
+        std::shuffle(begin(initial) + 1, end(initial) - 1, std::mt19937(seed));
+
+        TwoOptSearch twoOptSearch(distances);
+        vector<int> twoOptRoute{initial};
+        twoOptSearch.optimize(twoOptRoute);
+        twoOptLength += twoOptSearch.length(twoOptRoute);
+
+        DontLookBitsSearch dontLookSearch(distances);
+        vector<int> route{initial};
+        EXPECT_GT(dontLookSearch.optimize(route), 0);
+        dontLookLength += twoOptSearch.length(route);
+
+        EXPECT_EQ(route.front(), initial.front());
+        EXPECT_EQ(route.back(), initial.back());
+        vector<int> sorted{route};
+        std::sort(begin(sorted), end(sorted));
+        EXPECT_EQ(sorted, identityRoute(300));
+    }
+
+    EXPECT_LT(dontLookLength, twoOptLength);
+}
+
+TEST(DontLookBitsSearchTests, noImprovingThreeOptMoveLeft)
+{
+    DistanceMatrix distances = randomDistances(60, 41);
+    vector<int> route = identityRoute(60);
+    std::shuffle(begin(route) + 1, end(route) - 1, std::mt19937(41));
+    DontLookBitsSearch<DistanceMatrix> search(distances);
+    search.optimize(route);
+
+    TwoOptSearch lengthSearch(distances);
+    const double length = lengthSearch.length(route);
+    const int size = route.size();
+    for (int firstIndex = 0; firstIndex + 3 < size; firstIndex++)
+        for (int secondIndex = firstIndex + 1; secondIndex <= firstIndex + search.THREE_OPT_SEGMENT_LENGTH && secondIndex + 2 < size; secondIndex++)
+            for (int thirdIndex = secondIndex + 2; thirdIndex < size; thirdIndex++)
+                for (ThreeOptReconnection reconnection : {SWAP_SEGMENTS, SWAP_REVERSE_FIRST, SWAP_REVERSE_SECOND, REVERSE_BOTH})
+                {
+                    vector<int> moved{route};
+                    threeOpt(moved, firstIndex, secondIndex, thirdIndex, reconnection);
+                    ASSERT_GE(lengthSearch.length(moved), length - 1e-6) << firstIndex << " " << secondIndex << " " << thirdIndex;
+                }
+}
+
+TEST(DontLookBitsSearchTests, reoptimizingAfterPerturbationSkipsUnchangedElements)
+{
+    DistanceMatrix distances = randomDistances(1000, 29);
+    vector<int> route = identityRoute(1000);
+    DontLookBitsSearch dontLookSearch(distances);
+    DontLookBitsSearch withoutBitsSearch(distances, false);
+    dontLookSearch.optimize(route);
+    vector<int> withoutBitsRoute{route};
+
+    std::mt19937 generator(31);
+    const long long dontLookBefore = dontLookSearch.evaluatedMoves();
+    for (int perturbation = 0; perturbation < 10; perturbation++)
+    {
+        const int firstIndex = generator() % 900;
+        const int secondIndex = firstIndex + 3 + generator() % 90;
+        vector<int> changed{route[firstIndex], route[firstIndex + 1], route[secondIndex - 1], route[secondIndex]};
+        twoOpt(route, firstIndex, secondIndex);
+        twoOpt(withoutBitsRoute, firstIndex, secondIndex);
+
+        dontLookSearch.optimize(route, changed);
+        withoutBitsSearch.optimize(withoutBitsRoute);
+    }
+
+    const long long dontLookEvaluations = dontLookSearch.evaluatedMoves() - dontLookBefore;
+    std::cout << "evaluations: " << withoutBitsSearch.evaluatedMoves() << " (whole search) vs " << dontLookEvaluations
+              << " (don't-look bits)" << std::endl;
+    EXPECT_LT(dontLookEvaluations * 10, withoutBitsSearch.evaluatedMoves());
+}
+
+namespace
+{
+    vector<Point> randomPoints(int size, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> coordinate(0, 1000);
+        vector<Point> points(size);
+        for (auto &point : points)
+            point = Point{coordinate(generator), coordinate(generator)};
+
+        return points;
+    }
+}
+
+TEST(TiledDistanceOracleTests, distancesAndCounters)
+{
+    vector<Point> points = randomPoints(100, 37);
+    TiledDistanceOracle oracle(points, 1 << 20);
+
+    EXPECT_DOUBLE_EQ(oracle(3, 70), std::hypot(points[3].x - points[70].x, points[3].y - points[70].y));
+    EXPECT_EQ(oracle.misses(), 1);
+    EXPECT_EQ(oracle.hits(), 0);
+
+    // Same tile: the matrix is symmetric and 5 and 90 are in the same tiles as 3 and 70.
+    EXPECT_EQ(oracle(70, 3), oracle(3, 70));
+    EXPECT_DOUBLE_EQ(oracle(5, 90), std::hypot(points[5].x - points[90].x, points[5].y - points[90].y));
+    EXPECT_EQ(oracle(99, 99), 0);
+    EXPECT_EQ(oracle.misses(), 2);
+    EXPECT_EQ(oracle.hits(), 3);
+
+    oracle.resetCounters();
+    EXPECT_EQ(oracle.hits() + oracle.misses(), 0);
+}
+
+TEST(TiledDistanceOracleTests, boundedMemory)
+{
+    vector<Point> points = randomPoints(2000, 41);
+    const size_t budget = 8 * TiledDistanceOracle::TILE_BYTES;
+    TiledDistanceOracle oracle(points, budget);
+
+    for (int from = 0; from < 2000; from += 7)
+        for (int to = 0; to < 2000; to += 13)
+            ASSERT_DOUBLE_EQ(oracle(from, to), std::hypot(points[from].x - points[to].x, points[from].y - points[to].y));
+
+    EXPECT_LE(oracle.memoryFootprint(), budget);
+    EXPECT_GT(oracle.misses(), 8);
+}
+
+TEST(TiledDistanceOracleTests, usableByTwoOptSearch)
+{
+    vector<Point> points = randomPoints(300, 43);
+    TiledDistanceOracle oracle(points, 64 * TiledDistanceOracle::TILE_BYTES);
+    DistanceMatrix matrix(300, oracle);
+
+    TwoOptSearch oracleSearch(oracle);
+    TwoOptSearch matrixSearch(matrix);
+    vector<int> oracleRoute = identityRoute(300);
+    vector<int> matrixRoute = identityRoute(300);
+
+    EXPECT_EQ(oracleSearch.optimize(oracleRoute), matrixSearch.optimize(matrixRoute));
+    EXPECT_EQ(oracleRoute, matrixRoute);
+}
+
+TEST(CandidateListsTests, matchBruteForceNearestNeighbours)
+{
+    vector<Point> points = randomPoints(500, 47);
+    CandidateLists candidates(points, 8, 4);
+
+    ASSERT_EQ(candidates.size(), 500);
+    for (int id = 0; id < static_cast<int>(points.size()); id++)
+    {
+        vector<int> expected;
+        for (int other = 0; other < static_cast<int>(points.size()); other++)
+            if (other != id)
+                expected.push_back(other);
+
+        auto squaredDistance = [&points, id](int other)
+        { return std::pow(points[id].x - points[other].x, 2) + std::pow(points[id].y - points[other].y, 2); };
+        std::partial_sort(begin(expected), begin(expected) + 8, end(expected), [&squaredDistance](int first, int second)
+                          { return squaredDistance(first) < squaredDistance(second); });
+        expected.resize(8);
+
+        span<const int> neighbours = candidates.of(id);
+        ASSERT_EQ(vector<int>(neighbours.begin(), neighbours.end()), expected);
+    }
+
+    EXPECT_EQ(CandidateLists(randomPoints(3, 1), 8).neighboursPerElement(), 2);
+}
+
+TEST(CandidateListsTests, neighbourListSearch)
+{
+    vector<Point> points = randomPoints(2000, 53);
+    auto distance = [&points](int from, int to)
+    { return std::hypot(points[from].x - points[to].x, points[from].y - points[to].y); };
+    CandidateLists candidates(points, 10);
+
+    vector<int> initial = identityRoute(2000);
+    std::shuffle(begin(initial) + 1, end(initial) - 1, std::mt19937(59));
+
+    TwoOptSearch fullSearch(distance);
+    vector<int> fullRoute{initial};
+    fullSearch.optimize(fullRoute);
+
+    TwoOptSearch neighbourSearch(distance);
+    vector<int> route{initial};
+    EXPECT_GT(neighbourSearch.optimize(route, candidates), 0);
+
+    vector<int> sorted{route};
+    std::sort(begin(sorted), end(sorted));
+    EXPECT_EQ(sorted, identityRoute(2000));
+    EXPECT_EQ(route.front(), initial.front());
+    EXPECT_EQ(route.back(), initial.back());
+    EXPECT_LT(neighbourSearch.length(route), fullSearch.length(fullRoute) * 1.05);
+    EXPECT_LT(neighbourSearch.evaluatedMoves() * 10, fullSearch.evaluatedMoves());
+
+    TwoOptSearch tourSearch(distance);
+    ReversibleTour tour(initial);
+    tourSearch.optimize(tour, candidates);
+    EXPECT_EQ(tour.toVector(), route);
+}
+
+TEST(CandidateListsTests, noNeighbours)
+{
+    vector<Point> points = randomPoints(20, 61);
+    auto distance = [&points](int from, int to)
+    { return std::hypot(points[from].x - points[to].x, points[from].y - points[to].y); };
+
+    CandidateLists empty(points, 0, 2);
+    EXPECT_EQ(empty.size(), 20);
+    EXPECT_EQ(empty.neighboursPerElement(), 0);
+    EXPECT_TRUE(empty.of(7).empty());
+
+    // Without candidates no move is tried, and the route is left as it is
+    TwoOptSearch search(distance);
+    vector<int> route = identityRoute(20);
+    EXPECT_EQ(search.optimize(route, empty), 0);
+    EXPECT_EQ(route, identityRoute(20));
+
+    CandidateLists single(vector<Point>{Point{1, 2}}, 8);
+    EXPECT_EQ(single.size(), 1);
+    EXPECT_EQ(single.neighboursPerElement(), 0);
+    EXPECT_TRUE(single.of(0).empty());
+
+    EXPECT_THROW(CandidateLists(points, -1), InvalidNeighbourCountException);
+}
+
+TEST(TwoOptStatusTests, sameRulesAsExceptions)
+{
+    vector<int> shortRoute{1, 2, 3};
+    vector<int> route{1, 2, 3, 4, 5};
+    const vector<int> control{route};
+
+    EXPECT_EQ(tryTwoOpt(shortRoute, 1, 3), TOO_SHORT_ROUTE);
+    EXPECT_EQ(tryTwoOpt(route, 1, 3), TOO_SHORT_TWO_OPT_RANGE);
+    EXPECT_EQ(tryTwoOpt(route, 3, 4), INVALID_FIRST_INDEX);
+    EXPECT_EQ(tryTwoOpt(route, 1, 2), INVALID_SECOND_INDEX);
+    EXPECT_EQ(tryTwoOpt(route, 0, 5), INVALID_SECOND_INDEX);
+    EXPECT_EQ(tryTwoOpt(route, 0, 1000), INVALID_SECOND_INDEX);
+    EXPECT_THROW(twoOpt(route, 0, 1000), InvalidSecondIndexException);
+    EXPECT_EQ(route, control);
+
+    EXPECT_EQ(tryTwoOpt(route, 4, 0), VALID_TWO_OPT);
+    EXPECT_EQ(route, (vector<int>{1, 4, 3, 2, 5}));
+}
+
+TEST(TwoOptStatusTests, batchOfMoves)
+{
+    vector<int> route = identityRoute(12);
+    vector<int> expected{route};
+    twoOpt(expected, 0, 4);
+    twoOpt(expected, 4, 8);
+    twoOpt(expected, 11, 8);
+
+    vector<TwoOptMove> moves{{0, 4, 0}, {4, 8, 0}, {11, 8, 0}};
+    EXPECT_EQ(applyTwoOptMoves(route, moves), VALID_TWO_OPT);
+    EXPECT_EQ(route, expected);
+
+    vector<TwoOptMove> overlapping{{0, 5, 0}, {4, 8, 0}};
+    vector<TwoOptMove> invalid{{0, 4, 0}, {5, 7, 0}};
+    EXPECT_EQ(applyTwoOptMoves(route, overlapping), OVERLAPPING_TWO_OPT_MOVES);
+    EXPECT_EQ(applyTwoOptMoves(route, invalid), TOO_SHORT_TWO_OPT_RANGE);
+    vector<TwoOptMove> outOfRange{{0, 4, 0}, {5, 12, 0}};
+    EXPECT_EQ(applyTwoOptMoves(route, outOfRange), INVALID_SECOND_INDEX);
+    EXPECT_EQ(route, expected);
+}
@@ -1,3 +1,4 @@
+#include "routing/TwoOpt.h"
 #include <exception>
 #include <vector>
 #include <iostream>
@@ -5,6 +6,9 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <stdexcept>
+#include <algorithm>
+#include <random>
+#include <limits>
 using std::cout;
 using std::exception;
 using std::string;
@@ -51,6 +55,9 @@ public:
     {
         if (startParam > endParam)
             throw InvalidTimeWindowException("Start is later than end");
+
+        start = startParam;
+        end = endParam;
     }
 
     void setStart(int startParam)
@@ -85,7 +92,7 @@ public:
     Client(long long idParam, const string &nameParam, int timeWindowStart, int timeWindowEnd, double demandParam)
         : timeWindow(new TimeWindow(timeWindowStart, timeWindowEnd))
     {
-        if (id < 0)
+        if (idParam < 0)
             throw ClientException("Invalid negative param");
 
         id = idParam;
@@ -144,6 +151,168 @@ private:
     double demand;
 };
 
+/// Summary of a sequence of consecutive visits of a route: the window in which the service at its first
+/// visit can start, the minimum duration to serve all its visits (travel, service and waiting), the
+/// waiting time included in that duration, the time warp (how late the visits must be if a window can
+/// not be respected; zero when the sequence is feasible) and the total load. Two summaries can be
+/// concatenated in constant time, so the summary of any sequence built from known pieces is cheap.
+struct RouteSegment
+{
+    int earliestStart;
+    int latestStart;
+    int duration;
+    int waitingTime;
+    int timeWarp;
+    double load;
+    int first;
+    int last;
+
+    static RouteSegment visit(int index, int timeWindowStart, int timeWindowEnd, int serviceTime, double demand)
+    {
+        return RouteSegment{timeWindowStart, timeWindowEnd, serviceTime, 0, 0, demand, index, index};
+    }
+
+    static RouteSegment concatenate(const RouteSegment &head, const RouteSegment &tail, int travelTime)
+    {
+        const int delta = head.duration - head.timeWarp + travelTime;
+        const int deltaWaiting = std::max(tail.earliestStart - delta - head.latestStart, 0);
+        const int deltaTimeWarp = std::max(head.earliestStart + delta - tail.latestStart, 0);
+
+        return RouteSegment{std::max(tail.earliestStart - delta, head.earliestStart) - deltaWaiting,
+                            std::min(tail.latestStart - delta, head.latestStart) + deltaTimeWarp,
+                            head.duration + tail.duration + travelTime + deltaWaiting,
+                            head.waitingTime + tail.waitingTime + deltaWaiting,
+                            head.timeWarp + tail.timeWarp + deltaTimeWarp,
+                            head.load + tail.load,
+                            head.first,
+                            tail.last};
+    }
+
+    bool respectsTimeWindows() const { return timeWarp == 0; }
+};
+
+/// Time window and capacity feasibility of a route of clients, and of the twoOpt moves on it. The time
+/// windows and demands are read once from the clients, and the summaries of every prefix and suffix
+/// of the route are kept, so checking a reversal only concatenates three summaries. <<TravelTime>> is a
+/// callable returning the travel time between two clients given their indices in the clients vector.
+template <class TravelTime>
+class RouteFeasibility
+{
+
+public:
+    RouteFeasibility(const vector<const Client *> &clients, TravelTime travelTimeParam, double capacityParam, int serviceTime = 0)
+        : travelTime(std::move(travelTimeParam)), capacity(capacityParam)
+    {
+        visits.reserve(clients.size());
+        for (int index = 0; index < static_cast<int>(clients.size()); index++)
+        {
+            const TimeWindow *timeWindow = clients[index]->getTimeWindow();
+            visits.push_back(RouteSegment::visit(index, timeWindow->getStart(), timeWindow->getEnd(), serviceTime, clients[index]->getDemand()));
+        }
+    }
+
+    /// <<routeParam>> holds client indices. It may be empty, for a vehicle that is not used.
+    void setRoute(const vector<int> &routeParam)
+    {
+        route = routeParam;
+        prefixes.resize(route.size());
+        suffixes.resize(route.size());
+        updatePrefixes(0);
+        updateSuffixes(static_cast<int>(route.size()) - 1);
+    }
+
+    const vector<int> &getRoute() const { return route; }
+
+    /// Summary of the whole route. An empty route has no visit, no load and an unbounded window.
+    RouteSegment summary() const
+    {
+        if (prefixes.empty())
+            return RouteSegment{0, std::numeric_limits<int>::max(), 0, 0, 0, 0, -1, -1};
+
+        return prefixes.back();
+    }
+
+    bool isFeasible(const RouteSegment &segment) const
+    {
+        return segment.respectsTimeWindows() && segment.load <= capacity;
+    }
+
+    bool isFeasible() const { return isFeasible(summary()); }
+
+    /// Summary of the visits from <<from>> to <<to>> (both included) traversed backwards, in O(to - from).
+    RouteSegment reversedSegment(int from, int to) const
+    {
+        RouteSegment reversed = visits[route[to]];
+        for (int index = to - 1; index >= from; index--)
+            reversed = concatenate(reversed, visits[route[index]]);
+
+        return reversed;
+    }
+
+    /// Whether twoOpt(route, firstIndex, secondIndex) keeps the route feasible, given the summary of the
+    /// reversed visits (see reversedSegment and scanTwoOpt). Constant time, indices are not validated.
+    bool isTwoOptFeasible(int firstIndex, int secondIndex, const RouteSegment &reversedMiddle) const
+    {
+        return isFeasible(concatenate(concatenate(prefixes[firstIndex], reversedMiddle), suffixes[secondIndex]));
+    }
+
+    /// Same check without a known reversed summary: it is built by reversedSegment, in
+    /// O(secondIndex - firstIndex). To check every move from a first index, use scanTwoOpt.
+    bool isTwoOptFeasible(int firstIndex, int secondIndex) const
+    {
+        return isTwoOptFeasible(firstIndex, secondIndex, reversedSegment(firstIndex + 1, secondIndex - 1));
+    }
+
+    /// Calls onMove(secondIndex, feasible) for every twoOpt move starting at <<firstIndex>>. The reversed
+    /// segment grows by one visit per move, so each check is constant time.
+    template <class Callback>
+    void scanTwoOpt(int firstIndex, Callback onMove) const
+    {
+        RouteSegment reversed = visits[route[firstIndex + 1]];
+        for (int secondIndex = firstIndex + 3; secondIndex < static_cast<int>(route.size()); secondIndex++)
+        {
+            reversed = concatenate(visits[route[secondIndex - 1]], reversed);
+            onMove(secondIndex, isTwoOptFeasible(firstIndex, secondIndex, reversed));
+        }
+    }
+
+    /// Applies the move and only rebuilds the prefixes and the suffixes that contain reversed visits.
+    void applyTwoOpt(int firstIndex, int secondIndex)
+    {
+        twoOpt(route, firstIndex, secondIndex);
+        if (secondIndex < firstIndex)
+            std::swap(firstIndex, secondIndex);
+
+        updatePrefixes(firstIndex + 1);
+        updateSuffixes(secondIndex - 1);
+    }
+
+private:
+    RouteSegment concatenate(const RouteSegment &head, const RouteSegment &tail) const
+    {
+        return RouteSegment::concatenate(head, tail, travelTime(head.last, tail.first));
+    }
+
+    void updatePrefixes(int from)
+    {
+        for (int index = from; index < static_cast<int>(route.size()); index++)
+            prefixes[index] = index == 0 ? visits[route[0]] : concatenate(prefixes[index - 1], visits[route[index]]);
+    }
+
+    void updateSuffixes(int from)
+    {
+        for (int index = from; index >= 0; index--)
+            suffixes[index] = index + 1 == static_cast<int>(route.size()) ? visits[route[index]] : concatenate(visits[route[index]], suffixes[index + 1]);
+    }
+
+    TravelTime travelTime;
+    double capacity;
+    vector<RouteSegment> visits;
+    vector<int> route;
+    vector<RouteSegment> prefixes;
+    vector<RouteSegment> suffixes;
+};
+
 class MockClient : public Client
 {
 public:
@@ -253,4 +422,134 @@ TEST(ClientTest, testSetEmptyName)
                                  { mock.setName(""); });
     mock.settersExceptionWrapper([&mock]
                                  { mock.setName("some name"); });
-}
\ No newline at end of file
+}
+
+namespace
+{
+    // Visits the clients in order, starting each service as soon as possible.
+    bool naiveFeasibility(const vector<Client> &clients, const vector<int> &route, auto travelTime, int serviceTime, double capacity)
+    {
+        double load = clients[route[0]].getDemand();
+        int time = clients[route[0]].getTimeWindow()->getStart();
+
+        for (int index = 1; index < static_cast<int>(route.size()); index++)
+        {
+            const Client &client = clients[route[index]];
+            time = std::max(time + serviceTime + travelTime(route[index - 1], route[index]), client.getTimeWindow()->getStart());
+            load += client.getDemand();
+            if (time > client.getTimeWindow()->getEnd())
+                return false;
+        }
+
+        return load <= capacity;
+    }
+}
+
+TEST(RouteFeasibilityTest, concatenateSegments)
+{
+    RouteSegment first = RouteSegment::visit(0, 0, 10, 2, 1);
+    RouteSegment second = RouteSegment::visit(1, 20, 30, 2, 3);
+    RouteSegment third = RouteSegment::visit(2, 0, 15, 2, 5);
+
+    RouteSegment firstSecond = RouteSegment::concatenate(first, second, 5);
+    EXPECT_EQ(firstSecond.earliestStart, 10);
+    EXPECT_EQ(firstSecond.latestStart, 10);
+    EXPECT_EQ(firstSecond.duration, 2 + 5 + 3 + 2);
+    EXPECT_EQ(firstSecond.waitingTime, 3);
+    EXPECT_TRUE(firstSecond.respectsTimeWindows());
+    EXPECT_EQ(firstSecond.load, 4);
+
+    RouteSegment all = RouteSegment::concatenate(firstSecond, third, 1);
+    EXPECT_FALSE(all.respectsTimeWindows());
+    EXPECT_EQ(all.load, 9);
+}
+
+TEST(RouteFeasibilityTest, twoOptChecksMatchNaiveSimulation)
+{
+    const int size = 12;
+    const int serviceTime = 3;
+    std::mt19937 generator(5);
+    vector<Client> clients;
+    vector<int> positions;
+    for (int index = 0; index < size; index++)
+    {
+        const int start = generator() % 80;
+        clients.emplace_back(index, "client", start, start + 50 + generator() % 60, 1 + generator() % 4);
+        positions.push_back(generator() % 30);
+    }
+
+    vector<const Client *> clientPointers;
+    for (auto &client : clients)
+        clientPointers.push_back(&client);
+
+    auto travelTime = [&positions](int from, int to)
+    { return std::abs(positions[from] - positions[to]); };
+    const double capacity = 40;
+    RouteFeasibility feasibility(clientPointers, travelTime, capacity, serviceTime);
+
+    vector<int> route(size);
+    for (int index = 0; index < size; index++)
+        route[index] = index;
+    std::sort(begin(route), end(route), [&clients](int first, int second)
+              { return clients[first].getTimeWindow()->getStart() < clients[second].getTimeWindow()->getStart(); });
+    feasibility.setRoute(route);
+    EXPECT_EQ(feasibility.isFeasible(), naiveFeasibility(clients, route, travelTime, serviceTime, capacity));
+
+    int feasibleMoves = 0;
+    for (int move = 0; move < 5; move++)
+    {
+        for (int firstIndex = 0; firstIndex + 3 < size; firstIndex++)
+        {
+            feasibility.scanTwoOpt(firstIndex, [&](int secondIndex, bool feasible)
+                                   {
+                                       vector<int> moved{feasibility.getRoute()};
+                                       twoOpt(moved, firstIndex, secondIndex);
+                                       EXPECT_EQ(feasible, naiveFeasibility(clients, moved, travelTime, serviceTime, capacity));
+                                       EXPECT_EQ(feasible, feasibility.isTwoOptFeasible(firstIndex, secondIndex));
+                                       feasibleMoves += feasible; });
+        }
+
+        const int firstIndex = generator() % (size - 3);
+        const int secondIndex = firstIndex + 3 + generator() % (size - firstIndex - 3);
+        feasibility.applyTwoOpt(firstIndex, secondIndex);
+        twoOpt(route, firstIndex, secondIndex);
+        EXPECT_EQ(feasibility.getRoute(), route);
+        EXPECT_EQ(feasibility.isFeasible(), naiveFeasibility(clients, route, travelTime, serviceTime, capacity));
+    }
+
+    EXPECT_GT(feasibleMoves, 0);
+}
+
+TEST(RouteFeasibilityTest, capacity)
+{
+    Client first(1, "first", 0, 100, 6);
+    Client second(2, "second", 0, 100, 5);
+    auto travelTime = [](int, int)
+    { return 1; };
+
+    RouteFeasibility large({&first, &second}, travelTime, 11);
+    RouteFeasibility small({&first, &second}, travelTime, 10);
+    large.setRoute({0, 1});
+    small.setRoute({0, 1});
+
+    EXPECT_TRUE(large.isFeasible());
+    EXPECT_FALSE(small.isFeasible());
+}
+
+TEST(RouteFeasibilityTest, emptyRoute)
+{
+    Client first(1, "first", 0, 100, 6);
+    auto travelTime = [](int, int)
+    { return 1; };
+
+    // An unused vehicle
+    RouteFeasibility feasibility({&first}, travelTime, 10);
+    feasibility.setRoute({});
+    EXPECT_TRUE(feasibility.isFeasible());
+    EXPECT_EQ(feasibility.summary().load, 0);
+    EXPECT_EQ(feasibility.summary().duration, 0);
+
+    feasibility.setRoute({0});
+    EXPECT_TRUE(feasibility.isFeasible());
+    EXPECT_EQ(feasibility.summary().load, 6);
+}
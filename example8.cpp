@@ -1,4 +1,17 @@
-#include <iostream>
+#include "extended-vector/ExtendedVector.h"
+#include "extended-vector/ChunkedStorage.h"
+#include "extended-vector/SmallVectorStorage.h"
+#include "extended-vector/CompressedStorage.h"
+#include "extended-vector/ConcurrentExtendedVector.h"
+#include "extended-vector/SetOperations.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
@@ -8,65 +21,34 @@ using ::testing::_;
 using ::testing::AtLeast;
 using ::testing::Return;
 
-template <class T>
-class ExtendedVector
+namespace
 {
-
-public:
-    ExtendedVector() = delete;
-    ExtendedVector(const vector<T> &input)
+    /// Counts the allocations of the storages given a CountingAllocator, for the tests counting
+    /// allocations; the memory comes from the new/delete resource.
+    class CountingResource : public std::pmr::memory_resource
     {
-        for (auto &item : input)
+    public:
+        long long allocations() const { return allocationCount; }
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override
         {
-            container.push_back(item);
+            allocationCount++;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
         }
-    }
-
-    template <class... Ts>
-    ExtendedVector(Ts... elements)
-    {
-        (container.push_back(elements), ...);
-    }
-
-    template <class... Ts>
-    void insert(Ts... elements)
-    {
-        (container.push_back(elements), ...);
-    }
-
-    virtual size_t count() const
-    {
-        return container.size();
-    }
-
-    virtual int binarySearch(int start, int end, T &&value) const
-    {
-        if (start == end)
-            return container[start] == value ? start : -1;
 
-        int middle = (start + end) / 2;
-
-        if (container[middle] == value)
-            return middle;
-        if (container[middle] > value)
-            return binarySearch(start, middle, move(value));
-
-        return binarySearch(middle + 1, end, move(value));
-    }
-
-    void removeFirstFound(T &&value)
-    {
-        int index = binarySearch(0, container.size() - 1, value);
+        void do_deallocate(void *memory, size_t bytes, size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(memory, bytes, alignment);
+        }
 
-        if (index < 0)
-            return;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
 
-        container.erase(begin(container) + index);
-    }
+        long long allocationCount{0};
+    };
 
-private:
-    vector<T> container;
-};
+    using CountingAllocator = std::pmr::polymorphic_allocator<int>;
+}
 
 template <class T>
 class MockExtendedVector : public ExtendedVector<T>
@@ -122,4 +104,588 @@ TEST(ExtendedVectorTest, testAddRemoveAndCount)
     mock.count();
     mock.mockInsert();
     mock.count();
-}
\ No newline at end of file
+}
+
+namespace
+{
+    vector<int> sortedRandomValues(int size, int maximum, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> value(0, maximum);
+        vector<int> values(size);
+        for (auto &item : values)
+            item = value(generator);
+
+        std::sort(begin(values), end(values));
+        return values;
+    }
+}
+
+TEST(ExtendedVectorTest, searchModesAgree)
+{
+    for (int size : {0, 1, 2, 7, 8, 100, 1000, 4097})
+    {
+        // Duplicates and absent values
+        vector<int> values = sortedRandomValues(size, size, size);
+        ExtendedVector<int> extended(values);
+        vector<int> queries = sortedRandomValues(300, size + 2, size + 1);
+        queries.push_back(-1);
+
+        for (int query : queries)
+        {
+            const int expected = std::lower_bound(begin(values), end(values), query) - begin(values);
+            const bool present = expected < size && values[expected] == query;
+
+            extended.setSearchMode(BINARY_SEARCH);
+            const int binaryIndex = extended.find(query);
+            EXPECT_EQ(binaryIndex >= 0, present);
+            if (present)
+            {
+                EXPECT_EQ(values[binaryIndex], query);
+            }
+
+            for (SearchMode mode : {BRANCHLESS_SEARCH, EYTZINGER_SEARCH, KARY_SEARCH})
+            {
+                extended.setSearchMode(mode);
+                EXPECT_EQ(extended.lowerBound(query), expected);
+                EXPECT_EQ(extended.find(query), present ? expected : -1);
+            }
+        }
+
+        extended.setSearchMode(EYTZINGER_SEARCH);
+        vector<int> batch = extended.find(span<const int>(queries));
+        for (size_t i = 0; i < queries.size(); i++)
+            EXPECT_EQ(batch[i], extended.find(queries[i]));
+    }
+}
+
+TEST(ExtendedVectorTest, removeFirstFoundInEverySearchMode)
+{
+    for (SearchMode mode : {BINARY_SEARCH, BRANCHLESS_SEARCH, EYTZINGER_SEARCH, KARY_SEARCH})
+    {
+        ExtendedVector<int> extended(1, 2, 2, 3, 5, 8);
+        extended.setSearchMode(mode);
+
+        extended.removeFirstFound(2);
+        extended.removeFirstFound(4);
+        EXPECT_EQ(extended.count(), 5);
+        EXPECT_GE(extended.find(2), 0);
+
+        extended.removeFirstFound(2);
+        extended.removeFirstFound(8);
+        EXPECT_EQ(extended.count(), 3);
+        EXPECT_EQ(extended.find(2), -1);
+        EXPECT_EQ(extended.find(8), -1);
+        EXPECT_EQ(extended.find(5), 2);
+
+        extended.insert(13);
+        EXPECT_EQ(extended.find(13), 3);
+    }
+}
+
+TEST(ExtendedVectorTest, sortedInsert)
+{
+    ExtendedVector<int> extended(9, 3, 7);
+    extended.setInsertMode(SORTED_INSERT);
+    EXPECT_EQ(extended.find(3), 0);
+    EXPECT_EQ(extended.find(9), 2);
+
+    vector<int> expected{3, 7, 9};
+    std::mt19937 generator(17);
+    std::uniform_int_distribution<int> value(0, 500);
+
+    for (int round = 0; round < 50; round++)
+    {
+        const int single = value(generator);
+        extended.insert(single);
+        expected.push_back(single);
+        EXPECT_TRUE(extended.contains(single));
+
+        const int first = value(generator), second = value(generator), third = value(generator);
+        extended.insert(first, second, third);
+        expected.insert(end(expected), {first, second, third});
+
+        vector<int> batch = sortedRandomValues(round, 500, round);
+        std::shuffle(begin(batch), end(batch), generator);
+        extended.insertBatch(span<const int>(batch));
+        expected.insert(end(expected), begin(batch), end(batch));
+
+        EXPECT_EQ(extended.count(), expected.size());
+    }
+
+    std::sort(begin(expected), end(expected));
+    for (int query = -1; query <= 501; query++)
+    {
+        const bool present = std::binary_search(begin(expected), end(expected), query);
+        EXPECT_EQ(extended.contains(query), present);
+        const int index = extended.find(query);
+        EXPECT_EQ(index >= 0, present);
+        if (present)
+        {
+            EXPECT_EQ(expected[index], query);
+        }
+    }
+
+    // Removal from the insertion buffer and from the container
+    extended.insert(1000);
+    extended.removeFirstFound(1000);
+    EXPECT_FALSE(extended.contains(1000));
+    extended.removeFirstFound(int(expected[10]));
+    expected.erase(begin(expected) + 10);
+    EXPECT_EQ(extended.count(), expected.size());
+    for (size_t i = 0; i < expected.size(); i += 7)
+        EXPECT_EQ(extended.lowerBound(expected[i]), std::lower_bound(begin(expected), end(expected), expected[i]) - begin(expected));
+}
+
+TEST(ExtendedVectorTest, chunkedStorage)
+{
+    // Small chunks, so that they are split and merged many times
+    ExtendedVector<int, ChunkedStorage<int, 8>> extended(vector<int>{5, 1, 4});
+    extended.setInsertMode(SORTED_INSERT);
+    vector<int> expected{1, 4, 5};
+    std::mt19937 generator(23);
+    std::uniform_int_distribution<int> value(0, 300);
+
+    for (int round = 0; round < 2000; round++)
+    {
+        const int item = value(generator);
+        if (round % 3 == 2)
+        {
+            extended.removeFirstFound(int(item));
+            auto found = std::lower_bound(begin(expected), end(expected), item);
+            if (found != end(expected) && *found == item)
+                expected.erase(found);
+        }
+        else if (round % 50 == 0)
+        {
+            extended.insert(item, item + 1, item - 1);
+            expected.insert(end(expected), {item, item + 1, item - 1});
+            std::sort(begin(expected), end(expected));
+        }
+        else
+        {
+            extended.insert(item);
+            expected.insert(std::upper_bound(begin(expected), end(expected), item), item);
+        }
+    }
+
+    EXPECT_EQ(extended.count(), expected.size());
+    EXPECT_EQ(vector<int>(extended.begin(), extended.end()), expected);
+    EXPECT_GT(extended.storage().chunkCount(), expected.size() / 8);
+
+    for (SearchMode mode : {BINARY_SEARCH, BRANCHLESS_SEARCH, EYTZINGER_SEARCH, KARY_SEARCH})
+    {
+        extended.setSearchMode(mode);
+        for (int query = -2; query <= 302; query++)
+        {
+            const int expectedPosition = std::lower_bound(begin(expected), end(expected), query) - begin(expected);
+            const bool present = expectedPosition < static_cast<int>(expected.size()) && expected[expectedPosition] == query;
+            const int index = extended.find(query);
+            EXPECT_EQ(index >= 0, present);
+            if (present)
+            {
+                EXPECT_EQ(extended.storage()[index], query);
+            }
+            if (mode != BINARY_SEARCH)
+            {
+                EXPECT_EQ(extended.lowerBound(query), expectedPosition);
+            }
+        }
+    }
+
+    // Removing everything leaves no chunk behind
+    for (int item : vector<int>(expected))
+        extended.removeFirstFound(int(item));
+    EXPECT_EQ(extended.count(), 0);
+    EXPECT_EQ(extended.begin(), extended.end());
+}
+
+TEST(ExtendedVectorTest, smallStorageDoesNotAllocate)
+{
+    // Copies get the default resource, so it counts as well
+    CountingResource resource;
+    std::pmr::memory_resource *defaultResource = std::pmr::set_default_resource(&resource);
+    {
+        ExtendedVector<int, SmallVectorStorage<int, 16, CountingAllocator>> small(std::allocator_arg, CountingAllocator(&resource), 5, 1, 4, 2, 3);
+        small.insert(9, 7);
+        small.setInsertMode(SORTED_INSERT);
+        small.insert(8);
+        small.insert(6, 0);
+        small.removeFirstFound(4);
+
+        small.setSearchMode(BRANCHLESS_SEARCH);
+        EXPECT_EQ(small.count(), 9);
+        EXPECT_EQ(small.find(8), 7);
+        EXPECT_EQ(small.find(4), -1);
+        EXPECT_TRUE(small.storage().isInline());
+
+        ExtendedVector<int, SmallVectorStorage<int, 16, CountingAllocator>> copy{small};
+        EXPECT_TRUE(std::equal(copy.begin(), copy.end(), small.begin(), small.end()));
+    }
+    EXPECT_EQ(resource.allocations(), 0);
+
+    // The vector storage reserves all the elements of the variadic constructor at once
+    ExtendedVector<int, VectorStorage<int, CountingAllocator>> extended(std::allocator_arg, CountingAllocator(&resource), 1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    EXPECT_EQ(resource.allocations(), 1);
+
+    // Past the inline capacity the elements move to the heap, once per doubling
+    ExtendedVector<int, SmallVectorStorage<int, 4, CountingAllocator>> spilled(std::allocator_arg, CountingAllocator(&resource), 1, 2, 3);
+    const long long spilledAllocations = resource.allocations();
+    for (int value = 4; value <= 32; value++)
+        spilled.insert(value);
+    EXPECT_EQ(resource.allocations() - spilledAllocations, 3);
+    EXPECT_FALSE(spilled.storage().isInline());
+
+    ExtendedVector<int, SmallVectorStorage<int, 4, CountingAllocator>> moved{std::move(spilled)};
+    EXPECT_EQ(moved.count(), 32);
+    EXPECT_EQ(moved.storage()[31], 32);
+    std::pmr::set_default_resource(defaultResource);
+}
+
+TEST(ExtendedVectorTest, monotonicArenaAllocator)
+{
+    using ArenaAllocator = std::pmr::polymorphic_allocator<int>;
+    std::array<std::byte, 1 << 16> arena;
+    CountingResource upstream;
+    std::pmr::monotonic_buffer_resource resource(arena.data(), arena.size(), &upstream);
+
+    {
+        ExtendedVector<int, VectorStorage<int, ArenaAllocator>> large(std::allocator_arg, ArenaAllocator(&resource), 3, 1, 2);
+        ExtendedVector<int, SmallVectorStorage<int, 8, ArenaAllocator>> small(std::allocator_arg, ArenaAllocator(&resource), vector<int>{});
+        for (int value = 4; value <= 1000; value++)
+        {
+            large.insert(value);
+            small.insert(value);
+        }
+
+        large.setInsertMode(SORTED_INSERT);
+        large.setSearchMode(BRANCHLESS_SEARCH);
+        EXPECT_EQ(large.count(), 1000);
+        EXPECT_EQ(large.find(1), 0);
+        EXPECT_EQ(small.count(), 997);
+    }
+    // Everything came from the arena
+    EXPECT_EQ(upstream.allocations(), 0);
+}
+
+TEST(ExtendedVectorTest, bulkConstruction)
+{
+    // Takes the vector over
+    vector<int> input{4, 2, 9};
+    const int *data = input.data();
+    ExtendedVector<int> owner(std::move(input));
+    EXPECT_EQ(owner.storage().view().data(), data);
+    EXPECT_EQ(owner.count(), 3);
+
+    vector<int> values = sortedRandomValues(300000, 100000, 37);
+    std::shuffle(begin(values), end(values), std::mt19937(41));
+    vector<int> expected{values};
+    std::sort(begin(expected), end(expected));
+    vector<int> expectedUnique{expected};
+    expectedUnique.erase(std::unique(begin(expectedUnique), end(expectedUnique)), end(expectedUnique));
+
+    for (int threadCount : {1, 3, 8})
+    {
+        ExtendedVector<int> sorted(vector<int>(values), SORT, KARY_SEARCH, threadCount);
+        EXPECT_TRUE(std::equal(sorted.begin(), sorted.end(), begin(expected), end(expected)));
+        EXPECT_EQ(sorted.getInsertMode(), SORTED_INSERT);
+
+        ExtendedVector<int> unique(vector<int>(values), SORT_UNIQUE, EYTZINGER_SEARCH, threadCount);
+        EXPECT_TRUE(std::equal(unique.begin(), unique.end(), begin(expectedUnique), end(expectedUnique)));
+        for (int i = 0; i < static_cast<int>(expectedUnique.size()); i += 101)
+            EXPECT_EQ(unique.find(expectedUnique[i]), i);
+
+        ExtendedVector<int, ChunkedStorage<int>> chunked(vector<int>(values), SORT_UNIQUE, BRANCHLESS_SEARCH, threadCount);
+        EXPECT_TRUE(std::equal(chunked.begin(), chunked.end(), begin(expectedUnique), end(expectedUnique)));
+    }
+
+    ExtendedVector<int> kept(vector<int>(values), KEEP_ORDER);
+    EXPECT_TRUE(std::equal(kept.begin(), kept.end(), begin(values), end(values)));
+}
+
+// Every arithmetic type with an AVX2 kernel, plus types with the scalar one and a non arithmetic type
+template <class T>
+void expectKAryLowerBounds(const vector<T> &sorted, const vector<T> &queries)
+{
+    KAryLayout<T> layout{span<const T>(sorted)};
+    for (const T &query : queries)
+        EXPECT_EQ(layout.lowerBound(query), std::lower_bound(begin(sorted), end(sorted), query) - begin(sorted));
+}
+
+TEST(ExtendedVectorTest, kAryLayoutForEveryType)
+{
+    for (int size : {0, 1, 15, 16, 17, 272, 5000})
+    {
+        vector<int> values = sortedRandomValues(size, size, size + 11);
+        vector<int> queries = sortedRandomValues(200, size + 2, size + 13);
+        queries.push_back(-1);
+        if (size > 0)
+            queries.push_back(values.back());
+
+        auto convert = [](const vector<int> &items, auto scale)
+        {
+            vector<decltype(scale)> converted;
+            for (int item : items)
+                converted.push_back(item * scale);
+            return converted;
+        };
+
+        expectKAryLowerBounds(values, queries);
+        expectKAryLowerBounds(convert(values, 3LL), convert(queries, 3LL));
+        expectKAryLowerBounds(convert(values, 0.5f), convert(queries, 0.5f));
+        expectKAryLowerBounds(convert(values, 0.25), convert(queries, 0.25));
+        expectKAryLowerBounds(convert(values, short(1)), convert(queries, short(1)));
+        expectKAryLowerBounds(convert(values, 1u), convert(queries, 1u));
+
+        vector<std::string> strings, stringQueries;
+        for (int value : values)
+            strings.push_back(std::to_string(1000000 + value));
+        for (int query : queries)
+            stringQueries.push_back(std::to_string(1000000 + query));
+        expectKAryLowerBounds(strings, stringQueries);
+    }
+
+    // The largest value is also the padding of the last node
+    expectKAryLowerBounds(vector<int>{1, 5, INT32_MAX, INT32_MAX}, vector<int>{0, 5, 6, INT32_MAX});
+
+    // Infinite keys sort after the largest finite value, and so does the padding
+    const float infinity = std::numeric_limits<float>::infinity();
+    expectKAryLowerBounds(vector<float>{-infinity, 1, 2, infinity}, vector<float>{-infinity, 0, 2, std::numeric_limits<float>::max(), infinity});
+    expectKAryLowerBounds(vector<double>{1, std::numeric_limits<double>::infinity()}, vector<double>{1, 2, std::numeric_limits<double>::infinity()});
+    ExtendedVector<float> withInfinity(vector<float>{1, 2, infinity}, SORT, KARY_SEARCH);
+    EXPECT_EQ(withInfinity.find(infinity), 2);
+    EXPECT_EQ(withInfinity.lowerBound(infinity), 2);
+}
+
+TEST(ExtendedVectorTest, learnedSearch)
+{
+    // Nearly uniform keys with duplicates: the model fits with a small error
+    vector<int> uniform = sortedRandomValues(100000, 400000, 17);
+    ExtendedVector<int> extended(vector<int>(uniform), SORT, LEARNED_SEARCH);
+    EXPECT_TRUE(extended.learnedIndex().fits());
+    EXPECT_LE(extended.learnedIndex().maximumError(), LearnedIndex<int>::MAXIMUM_USEFUL_ERROR);
+    for (int query : sortedRandomValues(2000, 400010, 19))
+    {
+        const int expected = std::lower_bound(begin(uniform), end(uniform), query) - begin(uniform);
+        EXPECT_EQ(extended.lowerBound(query), expected);
+        EXPECT_EQ(extended.find(query), expected < static_cast<int>(uniform.size()) && uniform[expected] == query ? expected : -1);
+    }
+    EXPECT_EQ(extended.lowerBound(-1), 0);
+
+    // A jump at the end of a segment: the model does not fit and binarySearch is used instead
+    vector<long long> skewed;
+    for (long long i = 0; i < 1999; i++)
+        skewed.push_back(i * 2);
+    skewed.push_back(1000000000);
+    ExtendedVector<long long, ChunkedStorage<long long>> chunked(vector<long long>(skewed), SORT, LEARNED_SEARCH);
+    EXPECT_FALSE(chunked.learnedIndex().fits());
+    EXPECT_GT(chunked.learnedIndex().maximumError(), LearnedIndex<long long>::MAXIMUM_USEFUL_ERROR);
+    EXPECT_EQ(chunked.find(3000), 1500);
+    EXPECT_EQ(chunked.find(3001), -1);
+    EXPECT_EQ(chunked.lowerBound(3001), 1501);
+    EXPECT_EQ(chunked.find(1000000000), 1999);
+
+    // Insertions rebuild the model, which then fits again
+    chunked.removeFirstFound(1000000000);
+    chunked.insert(3001LL);
+    EXPECT_TRUE(chunked.learnedIndex().fits());
+    EXPECT_EQ(chunked.find(3001), 1501);
+    EXPECT_EQ(chunked.lowerBound(4000), 2000);
+
+    ExtendedVector<std::string> strings(vector<std::string>{"a", "b", "c"}, SORT, LEARNED_SEARCH);
+    EXPECT_FALSE(strings.learnedIndex().fits());
+    EXPECT_EQ(strings.find("b"), 1);
+}
+
+TEST(ExtendedVectorTest, concurrentSnapshots)
+{
+    ConcurrentExtendedVector<int> shared(vector<int>{5, 1, 3}, SORT, EYTZINGER_SEARCH, 4);
+    shared.insert(4);
+    shared.removeFirstFound(1);
+    EXPECT_EQ(shared.pendingCount(), 2);
+    EXPECT_EQ(shared.find(4), -1);
+
+    {
+        auto before = shared.snapshot();
+        shared.publish();
+        EXPECT_EQ(shared.find(4), 1);
+        EXPECT_EQ(shared.find(1), -1);
+
+        // The old version stays readable, and is not deleted, while a snapshot uses it
+        EXPECT_EQ(before->count(), 3);
+        EXPECT_EQ(before->find(1), 0);
+        EXPECT_EQ(shared.retiredCount(), 1);
+    }
+
+    // Every publishEvery changes the writer publishes by itself, and deletes the unused versions
+    for (int value : {6, 7, 8, 9})
+        shared.insert(value);
+    EXPECT_EQ(shared.pendingCount(), 0);
+    EXPECT_EQ(shared.retiredCount(), 0);
+    EXPECT_EQ(shared.count(), 7);
+    EXPECT_EQ(shared.find(9), 6);
+
+    shared.update([](ExtendedVector<int> &version)
+                  { version.setSearchMode(LEARNED_SEARCH); });
+    EXPECT_EQ(shared.snapshot()->getSearchMode(), LEARNED_SEARCH);
+    EXPECT_TRUE(shared.contains(7));
+
+    // Readers never see a half applied batch: the writer inserts -i and i together
+    ConcurrentExtendedVector<int> pairs(vector<int>{0}, SORT, BRANCHLESS_SEARCH, 2);
+    std::atomic<bool> done{false};
+    std::atomic<int> inconsistencies{0};
+    vector<std::thread> readers;
+    for (int reader = 0; reader < 3; reader++)
+        readers.emplace_back([&, reader]()
+                             {
+                                 std::mt19937 random(reader);
+                                 while (!done)
+                                 {
+                                     auto version = pairs.snapshot();
+                                     const int largest = version->storage()[version->count() - 1];
+                                     const int value = random() % (largest + 1);
+                                     if (version->count() % 2 != 1 || version->find(value) < 0 || version->find(-value) < 0)
+                                         inconsistencies++;
+                                 } });
+
+    for (int value = 1; value <= 2000; value++)
+    {
+        pairs.insert(value);
+        pairs.insert(-value);
+    }
+    done = true;
+    for (std::thread &reader : readers)
+        reader.join();
+
+    EXPECT_EQ(inconsistencies, 0);
+    EXPECT_EQ(pairs.count(), 4001);
+}
+
+TEST(ExtendedVectorTest, setOperations)
+{
+    auto postings = [](int size, int maximum, unsigned seed, int offset)
+    {
+        vector<int> values = sortedRandomValues(size, maximum, seed);
+        for (int &value : values)
+            value += offset;
+        return ExtendedVector<int>(move(values), SORT_UNIQUE);
+    };
+
+    // Sizes around the blocks of 8 keys, and ratios above GALLOPING_RATIO
+    for (int aSize : {0, 5, 8, 17, 300, 4000})
+        for (int bSize : {0, 7, 16, 250, 5000, 200000})
+        {
+            const ExtendedVector<int> a = postings(aSize, 2 * aSize + bSize, aSize, -aSize);
+            const ExtendedVector<int> b = postings(bSize, 2 * aSize + bSize, bSize + 1, -aSize);
+            vector<int> expected, output(a.count() + b.count());
+
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+            output.resize(sortedIntersection(a, b, span<int>(output)));
+            EXPECT_EQ(output, expected);
+            output.resize(a.count() + b.count());
+            output.resize(gallopingIntersection(a, b, span<int>(output)));
+            EXPECT_EQ(output, expected);
+
+            expected.clear();
+            output.resize(a.count() + b.count());
+            std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+            output.resize(sortedDifference(a, b, span<int>(output)));
+            EXPECT_EQ(output, expected);
+
+            expected.clear();
+            output.resize(a.count() + b.count());
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(expected));
+            output.resize(sortedUnion(a, b, span<int>(output)));
+            EXPECT_EQ(output, expected);
+        }
+
+    // In place, and for other key types (the scalar kernels)
+    vector<int> inPlace{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17};
+    const vector<int> odd{1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31};
+    inPlace.resize(sortedIntersection(span<const int>(inPlace), span<const int>(odd), span<int>(inPlace)));
+    EXPECT_EQ(inPlace, vector<int>({1, 3, 5, 7, 9, 11, 13, 15, 17}));
+    inPlace.resize(sortedDifference(span<const int>(inPlace), span<const int>(vector<int>{3, 9}), span<int>(inPlace)));
+    EXPECT_EQ(inPlace, vector<int>({1, 5, 7, 11, 13, 15, 17}));
+
+    const vector<unsigned> big{1, 2, 3000000000u, 4000000000u};
+    vector<unsigned> unsignedOutput(4);
+    unsignedOutput.resize(sortedIntersection(span<const unsigned>(big), span<const unsigned>(vector<unsigned>{2, 4000000000u}), span<unsigned>(unsignedOutput)));
+    EXPECT_EQ(unsignedOutput, vector<unsigned>({2, 4000000000u}));
+    vector<double> doubles(3);
+    doubles.resize(sortedUnion(span<const double>(vector<double>{0.5}), span<const double>(vector<double>{0.25, 1}), span<double>(doubles)));
+    EXPECT_EQ(doubles, vector<double>({0.25, 0.5, 1}));
+
+    // Several lists, into preallocated buffers
+    const ExtendedVector<int> first(1, 2, 3, 4, 5, 6), second(2, 4, 6, 8), third(4, 5, 6, 7);
+    vector<int> common(4), onlyFirst(6), any(14), pairUnion(8), scratch(14);
+    common.resize(sortedIntersection({&first, &second, &third}, span<int>(common)));
+    onlyFirst.resize(sortedDifference({&first, &second, &third}, span<int>(onlyFirst)));
+    any.resize(sortedUnion({&first, &second, &third}, span<int>(any), span<int>(scratch)));
+    pairUnion.resize(sortedUnion({&second, &third}, span<int>(pairUnion), span<int>(scratch)));
+
+    EXPECT_EQ(common, vector<int>({4, 6}));
+    EXPECT_EQ(onlyFirst, vector<int>({1, 3}));
+    EXPECT_EQ(any, vector<int>({1, 2, 3, 4, 5, 6, 7, 8}));
+    EXPECT_EQ(pairUnion, vector<int>({2, 4, 5, 6, 7, 8}));
+}
+
+TEST(ExtendedVectorTest, compressedStorage)
+{
+    // Ids close together, starting below zero, with a partial block at the end
+    std::mt19937 random(41);
+    vector<int> ids{-1000};
+    for (int i = 1; i < 100000; i++)
+        ids.push_back(ids.back() + 1 + random() % 4);
+
+    ExtendedVector<int, CompressedStorage<int>> compressed(vector<int>(ids), SORT);
+    EXPECT_EQ(compressed.count(), ids.size());
+    EXPECT_TRUE(std::equal(compressed.begin(), compressed.end(), ids.begin(), ids.end()));
+    // The ids take about 8.5 bits each, the block headers included
+    EXPECT_LT(compressed.storage().memoryBytes() * 3, ids.size() * sizeof(int));
+
+    for (SearchMode mode : {BINARY_SEARCH, BRANCHLESS_SEARCH, EYTZINGER_SEARCH, KARY_SEARCH, LEARNED_SEARCH})
+    {
+        compressed.setSearchMode(mode);
+        for (int query = -1001; query < ids.back() + 2; query += 97)
+        {
+            const int expected = std::lower_bound(begin(ids), end(ids), query) - begin(ids);
+            EXPECT_EQ(compressed.lowerBound(query), expected);
+            EXPECT_EQ(compressed.find(query), expected < static_cast<int>(ids.size()) && ids[expected] == query ? expected : -1);
+        }
+    }
+
+    // Changes re-encode the blocks after the first changed one
+    vector<int> expected{ids};
+    for (int value : {ids[300] + 1, ids.back() + 5, -2000, ids[70000]})
+    {
+        compressed.insert(value);
+        expected.insert(std::upper_bound(begin(expected), end(expected), value), value);
+    }
+    compressed.insert(ids[5] + 1, ids[99000] + 1, ids[256]);
+    for (int value : {ids[5] + 1, ids[99000] + 1, ids[256]})
+        expected.insert(std::upper_bound(begin(expected), end(expected), value), value);
+    for (int value : {ids[0], ids[512], ids[99999]})
+    {
+        compressed.removeFirstFound(move(value));
+        expected.erase(std::lower_bound(begin(expected), end(expected), value));
+    }
+    EXPECT_TRUE(std::equal(compressed.begin(), compressed.end(), expected.begin(), expected.end()));
+
+    // Any order, and offsets of all 32 bits
+    vector<int> extremes;
+    for (int i = 0; i < 600; i++)
+        extremes.push_back(i % 3 == 0 ? std::numeric_limits<int>::min() + i : std::numeric_limits<int>::max() - i);
+    ExtendedVector<int, CompressedStorage<int>> unsorted(extremes);
+    EXPECT_TRUE(std::equal(unsorted.begin(), unsorted.end(), extremes.begin(), extremes.end()));
+    EXPECT_EQ(unsorted.storage()[599], extremes[599]);
+    unsorted.setInsertMode(SORTED_INSERT);
+    std::sort(begin(extremes), end(extremes));
+    EXPECT_TRUE(std::equal(unsorted.begin(), unsorted.end(), extremes.begin(), extremes.end()));
+
+    vector<short> shorts;
+    for (int i = -300; i < 300; i++)
+        shorts.push_back(i * 7);
+    ExtendedVector<short, CompressedStorage<short>> compressedShorts(vector<short>(shorts), SORT);
+    EXPECT_TRUE(std::equal(compressedShorts.begin(), compressedShorts.end(), shorts.begin(), shorts.end()));
+    EXPECT_EQ(compressedShorts.find(short(-7)), 299);
+}
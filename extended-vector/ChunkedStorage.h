@@ -0,0 +1,296 @@
+#pragma once
+#include "EytzingerLayout.h"
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// ExtendedVector storage made of sorted chunks of at most <<CHUNK_SIZE>> elements, the leaves of a
+/// B+-tree, under a small index: the last element of every chunk, to find the chunk of a value, and
+/// a Fenwick tree over the chunk sizes, to find the chunk of a position. Inserting or erasing an
+/// element only moves the elements of its chunk, so it costs O(CHUNK_SIZE + log n) instead of O(n).
+/// A full chunk is split in two and a chunk that gets too small is merged with a neighbour; only
+/// then the index is rebuilt, in O(n / CHUNK_SIZE).
+template <class T, int CHUNK_SIZE = 256>
+class ChunkedStorage
+{
+
+public:
+    static_assert(CHUNK_SIZE >= 4);
+    static constexpr bool CONTIGUOUS = false;
+
+    class const_iterator
+    {
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator() = default;
+        const_iterator(const vector<vector<T>> *chunksParam, size_t chunkParam, size_t offsetParam)
+            : chunks(chunksParam), chunk(chunkParam), offset(offsetParam) {}
+
+        reference operator*() const { return (*chunks)[chunk][offset]; }
+        pointer operator->() const { return &(*chunks)[chunk][offset]; }
+
+        const_iterator &operator++()
+        {
+            if (++offset == (*chunks)[chunk].size())
+            {
+                chunk++;
+                offset = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator &other) const { return chunk == other.chunk && offset == other.offset; }
+
+    private:
+        const vector<vector<T>> *chunks{};
+        size_t chunk{};
+        size_t offset{};
+    };
+
+    size_t size() const { return total; }
+    bool empty() const { return total == 0; }
+    const_iterator begin() const { return const_iterator(&chunks, 0, 0); }
+    const_iterator end() const { return const_iterator(&chunks, chunks.size(), 0); }
+    size_t chunkCount() const { return chunks.size(); }
+
+    const T &operator[](size_t position) const
+    {
+        const size_t chunk = chunkOfPosition(position);
+        return chunks[chunk][position];
+    }
+
+    /// Chunks are allocated when they are needed.
+    void reserve(size_t) {}
+
+    void push_back(const T &value)
+    {
+        if (chunks.empty() || chunks.back().size() >= CHUNK_SIZE)
+        {
+            chunks.emplace_back().reserve(CHUNK_SIZE);
+            lastElements.push_back(value);
+            fenwick.push_back(0);
+            // The new node of the Fenwick tree covers the sizes of the chunks (i - lowbit(i), i]
+            const size_t node = chunks.size();
+            fenwick[node - 1] = prefixSize(node - 1) - prefixSize(node - (node & -node));
+        }
+
+        chunks.back().push_back(value);
+        lastElements.back() = value;
+        addSize(chunks.size() - 1, 1);
+        total++;
+    }
+
+    void assign(vector<T> &&items)
+    {
+        rebuild(span<const T>(items));
+    }
+
+    void append(span<const T> items)
+    {
+        for (const T &item : items)
+            push_back(item);
+    }
+
+    void eraseAt(size_t position)
+    {
+        const size_t chunk = chunkOfPosition(position);
+        chunks[chunk].erase(chunks[chunk].begin() + position);
+        total--;
+
+        if (chunks[chunk].size() >= CHUNK_SIZE / 4)
+        {
+            lastElements[chunk] = chunks[chunk].back();
+            addSize(chunk, -1);
+        }
+        else
+            mergeSmallChunk(chunk);
+    }
+
+    /// Sorts the elements and refills the chunks three quarters full, leaving room for insertions.
+    void sort()
+    {
+        vector<T> values(begin(), end());
+        std::sort(values.begin(), values.end());
+        rebuild(span<const T>(values));
+    }
+
+    /// Position of the first element not less than <<value>>. The elements must be sorted.
+    size_t lowerBound(const T &value) const
+    {
+        const size_t chunk = branchlessLowerBound(span<const T>(lastElements), value);
+        if (chunk == chunks.size())
+            return total;
+
+        return prefixSize(chunk) + branchlessLowerBound(span<const T>(chunks[chunk]), value);
+    }
+
+    /// Inserts <<value>> in its chunk, after the elements equal to it. The elements must be sorted.
+    void insertSorted(const T &value)
+    {
+        if (chunks.empty())
+        {
+            push_back(value);
+            return;
+        }
+
+        // The first chunk whose last element is greater than the value, or the last one
+        size_t chunk = std::upper_bound(lastElements.begin(), lastElements.end(), value) - lastElements.begin();
+        chunk = std::min(chunk, chunks.size() - 1);
+
+        vector<T> &elements = chunks[chunk];
+        elements.insert(std::upper_bound(elements.begin(), elements.end(), value), value);
+        lastElements[chunk] = elements.back();
+        total++;
+
+        if (elements.size() <= CHUNK_SIZE)
+        {
+            addSize(chunk, 1);
+            return;
+        }
+
+        // Split the full chunk in two halves
+        vector<T> upperHalf;
+        upperHalf.reserve(CHUNK_SIZE);
+        upperHalf.assign(elements.begin() + elements.size() / 2, elements.end());
+        elements.erase(elements.begin() + elements.size() / 2, elements.end());
+        chunks.insert(chunks.begin() + chunk + 1, move(upperHalf));
+        rebuildIndex();
+    }
+
+    /// Merges sorted values into the sorted elements. Small batches are inserted one by one, in their
+    /// chunks; large ones rebuild the chunks in one pass.
+    void mergeSorted(span<const T> sorted)
+    {
+        if (sorted.size() * 16 < total)
+        {
+            for (const T &value : sorted)
+                insertSorted(value);
+            return;
+        }
+
+        vector<T> values;
+        values.reserve(total + sorted.size());
+        std::merge(begin(), end(), sorted.begin(), sorted.end(), std::back_inserter(values));
+        rebuild(span<const T>(values));
+    }
+
+private:
+    /// Chunk holding <<position>>, which becomes the position inside the chunk.
+    size_t chunkOfPosition(size_t &position) const
+    {
+        // Fenwick tree descent: the largest prefix of chunks with at most <<position>> elements
+        size_t chunk = 0;
+        size_t step = 1;
+        while (step * 2 <= chunks.size())
+            step *= 2;
+
+        for (; step > 0; step /= 2)
+            if (chunk + step <= chunks.size() && fenwick[chunk + step - 1] <= position)
+            {
+                chunk += step;
+                position -= fenwick[chunk - 1];
+            }
+
+        return chunk;
+    }
+
+    /// Elements in the chunks before <<chunk>>.
+    size_t prefixSize(size_t chunk) const
+    {
+        size_t size = 0;
+        for (; chunk > 0; chunk -= chunk & -chunk)
+            size += fenwick[chunk - 1];
+
+        return size;
+    }
+
+    void addSize(size_t chunk, long long delta)
+    {
+        for (size_t node = chunk + 1; node <= chunks.size(); node += node & -node)
+            fenwick[node - 1] += delta;
+    }
+
+    void mergeSmallChunk(size_t chunk)
+    {
+        // Merge into the smallest neighbour when both fit in one chunk, or drop the chunk if it is empty
+        size_t target = chunk;
+        if (chunk > 0 && chunks[chunk - 1].size() + chunks[chunk].size() <= CHUNK_SIZE)
+            target = chunk - 1;
+        if (chunk + 1 < chunks.size() && chunks[chunk + 1].size() + chunks[chunk].size() <= CHUNK_SIZE &&
+            (target == chunk || chunks[chunk + 1].size() < chunks[target].size()))
+            target = chunk + 1;
+
+        if (target == chunk && !chunks[chunk].empty())
+        {
+            lastElements[chunk] = chunks[chunk].back();
+            addSize(chunk, -1);
+            return;
+        }
+
+        if (target < chunk)
+            chunks[target].insert(chunks[target].end(), chunks[chunk].begin(), chunks[chunk].end());
+        else if (target > chunk)
+            chunks[target].insert(chunks[target].begin(), chunks[chunk].begin(), chunks[chunk].end());
+
+        chunks.erase(chunks.begin() + chunk);
+        rebuildIndex();
+    }
+
+    void rebuild(span<const T> sorted)
+    {
+        chunks.clear();
+        const size_t fill = CHUNK_SIZE * 3 / 4;
+        for (size_t first = 0; first < sorted.size(); first += fill)
+        {
+            vector<T> &elements = chunks.emplace_back();
+            elements.reserve(CHUNK_SIZE);
+            elements.assign(sorted.begin() + first, sorted.begin() + std::min(sorted.size(), first + fill));
+        }
+
+        rebuildIndex();
+    }
+
+    void rebuildIndex()
+    {
+        lastElements.clear();
+        fenwick.clear();
+        total = 0;
+        for (auto &elements : chunks)
+        {
+            lastElements.push_back(elements.back());
+            fenwick.push_back(elements.size());
+            total += elements.size();
+        }
+
+        // Linear time construction: every node adds its sum to its parent
+        for (size_t node = 1; node <= fenwick.size(); node++)
+        {
+            const size_t parent = node + (node & -node);
+            if (parent <= fenwick.size())
+                fenwick[parent - 1] += fenwick[node - 1];
+        }
+    }
+
+    vector<vector<T>> chunks;
+    vector<T> lastElements;
+    vector<size_t> fenwick;
+    size_t total{};
+};
@@ -0,0 +1,398 @@
+#pragma once
+#include "EytzingerLayout.h"
+#include "KAryLayout.h"
+#include <vector>
+#include <span>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+using std::move;
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// ExtendedVector storage for large sets of integers close together, e.g. sorted ids. The elements
+/// are cut in blocks of BLOCK_SIZE, each stored as a frame of reference, base + index * slope (the
+/// line through the block, or just its smallest element when that needs fewer bits), and the offsets
+/// of the elements from it, bit-packed with as many bits as the largest one needs. Ids with gaps of
+/// 1 to 4 take about 8.5 bits instead of 32, the block headers included. The last elements, less
+/// than a block, stay uncompressed until the block is full.
+/// The offsets of a block are interleaved in 8 lanes, as 8 consecutive elements are decoded at once
+/// by the AVX2 kernel: element i is in lane i % 8, at bit (i / 8) * width of the lane. Any element is
+/// still decoded in O(1), so operator[] and the searches work on the compressed data directly, and
+/// the first element of every block forms a skip index for lowerBound.
+/// Appending is cheap; the other changes rebuild the blocks after the first changed one.
+template <class T, int BLOCK_SIZE = 256>
+class CompressedStorage
+{
+
+public:
+    static_assert(std::is_integral_v<T> && sizeof(T) <= 4, "The offsets are packed in 32-bit words");
+    static_assert(BLOCK_SIZE % 256 == 0, "Every lane of a block must fill whole words whatever the width");
+    static constexpr bool CONTIGUOUS = false;
+    static constexpr int LANES = 8;
+
+    /// Decodes a block at a time into a buffer of its own, so it is an input iterator.
+    class const_iterator
+    {
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator() = default;
+        const_iterator(const CompressedStorage *storageParam, size_t position)
+            : storage(storageParam), block(position / BLOCK_SIZE), index(position % BLOCK_SIZE)
+        {
+            decode();
+        }
+
+        reference operator*() const { return current[index]; }
+        pointer operator->() const { return &current[index]; }
+
+        const_iterator &operator++()
+        {
+            if (++index == BLOCK_SIZE)
+            {
+                index = 0;
+                block++;
+                decode();
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator &other) const { return block == other.block && index == other.index; }
+
+    private:
+        void decode()
+        {
+            if (block < storage->blocks.size())
+                storage->decodeBlock(block, current.data());
+            else if (index < storage->tail.size())
+                std::copy(storage->tail.begin(), storage->tail.end(), current.begin());
+        }
+
+        const CompressedStorage *storage{};
+        size_t block{};
+        size_t index{};
+        std::array<T, BLOCK_SIZE> current;
+    };
+
+    size_t size() const { return blocks.size() * BLOCK_SIZE + tail.size(); }
+    bool empty() const { return size() == 0; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+    size_t blockCount() const { return blocks.size(); }
+
+    /// Bytes used by the elements and the index, as opposed to size() * sizeof(T) uncompressed.
+    size_t memoryBytes() const
+    {
+        return words.capacity() * sizeof(std::uint32_t) + blocks.capacity() * sizeof(Block) +
+               firstElements.capacity() * sizeof(T) + tail.capacity() * sizeof(T);
+    }
+
+    /// Decoded in O(1), so it is returned by value.
+    T operator[](size_t position) const
+    {
+        const size_t block = position / BLOCK_SIZE;
+        if (block == blocks.size())
+            return tail[position % BLOCK_SIZE];
+
+        return element(words.data(), blocks[block], position % BLOCK_SIZE);
+    }
+
+    /// Blocks are packed when they are full.
+    void reserve(size_t) {}
+
+    void push_back(const T &value)
+    {
+        tail.push_back(value);
+        if (tail.size() == BLOCK_SIZE)
+        {
+            encodeBlock(span<const T>(tail));
+            tail.clear();
+        }
+    }
+
+    void assign(vector<T> &&items)
+    {
+        clear();
+        append(span<const T>(items));
+        words.shrink_to_fit();
+    }
+
+    void append(span<const T> items)
+    {
+        for (const T &item : items)
+            push_back(item);
+    }
+
+    void eraseAt(size_t position)
+    {
+        rebuildFrom(position / BLOCK_SIZE, [position](size_t current, const T &, auto &&)
+                    { return current != position; });
+    }
+
+    /// Decodes all the elements: it needs the memory of the uncompressed data.
+    void sort()
+    {
+        vector<T> values = decodeAll();
+        std::sort(values.begin(), values.end());
+        assign(move(values));
+    }
+
+    /// Position of the first element not less than <<value>>. The elements must be sorted.
+    size_t lowerBound(const T &value) const
+    {
+        // The last block whose first element is smaller than the value holds the answer, or ends just before it
+        const size_t next = branchlessLowerBound(span<const T>(firstElements), value);
+        if (next == 0 && !blocks.empty())
+            return 0;
+
+        if (next > 0)
+        {
+            const Block &block = blocks[next - 1];
+            size_t low = 1, high = BLOCK_SIZE;
+            while (low < high)
+            {
+                const size_t middle = (low + high) / 2;
+                if (element(words.data(), block, middle) < value)
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+
+            if (low < BLOCK_SIZE || next < blocks.size())
+                return (next - 1) * BLOCK_SIZE + low;
+        }
+
+        return blocks.size() * BLOCK_SIZE + (std::lower_bound(tail.begin(), tail.end(), value) - tail.begin());
+    }
+
+    /// Merges sorted values into the sorted elements, re-encoding the blocks from the first one
+    /// holding an element greater than the smallest value.
+    void mergeSorted(span<const T> sorted)
+    {
+        if (sorted.empty())
+            return;
+
+        const size_t first = std::upper_bound(firstElements.begin(), firstElements.end(), sorted.front()) - firstElements.begin();
+        size_t next = 0;
+        rebuildFrom(first == 0 ? 0 : first - 1, [&next, sorted](size_t, const T &element, auto &&output)
+                    {
+                        // New values go after the old ones equal to them
+                        while (next < sorted.size() && sorted[next] < element)
+                            output(sorted[next++]);
+                        return true; });
+        for (; next < sorted.size(); next++)
+            push_back(sorted[next]);
+    }
+
+    /// Decodes the block <<block>> into <<output>>, BLOCK_SIZE elements.
+    void decodeBlock(size_t block, T *output) const
+    {
+        decode(words.data(), blocks[block], output);
+    }
+
+private:
+    using Offset = std::uint32_t;
+
+    /// Element i is base + i * slope + offset i, modulo 2^32
+    struct Block
+    {
+        Offset base;
+        Offset slope;
+        std::uint32_t firstWord;
+        std::uint8_t width;
+    };
+
+    /// Elements of a lane in a block
+    static constexpr int SLOTS = BLOCK_SIZE / LANES;
+
+    static Offset mask(int width) { return width == 32 ? ~Offset{0} : (Offset{1} << width) - 1; }
+
+    /// Element <<index>> of <<block>>, whose offsets are in <<allWords>>.
+    static T element(const std::uint32_t *allWords, const Block &block, size_t index)
+    {
+        const Offset frame = block.base + static_cast<Offset>(index) * block.slope;
+        if (block.width == 0)
+            return static_cast<T>(frame);
+
+        const size_t bit = index / LANES * block.width;
+        const size_t word = block.firstWord + bit / 32 * LANES + index % LANES;
+        const int shift = bit % 32;
+        std::uint64_t bits = allWords[word];
+        // The offset continues in the next word of the lane
+        if (shift + block.width > 32)
+            bits |= std::uint64_t{allWords[word + LANES]} << 32;
+
+        return static_cast<T>(frame + (static_cast<Offset>(bits >> shift) & mask(block.width)));
+    }
+
+    static void decode(const std::uint32_t *allWords, const Block &block, T *output)
+    {
+#ifdef KARY_AVX2_KERNELS
+        if (KAryKernels::avx2Supported())
+        {
+            decodeAvx2(allWords, block, output);
+            return;
+        }
+#endif
+        for (int i = 0; i < BLOCK_SIZE; i++)
+            output[i] = element(allWords, block, i);
+    }
+
+#ifdef KARY_AVX2_KERNELS
+    /// Decodes 8 elements per step: the same bits of the 8 lanes are in 8 consecutive words.
+    __attribute__((target("avx2"))) static void decodeAvx2(const std::uint32_t *allWords, const Block &block, T *output)
+    {
+        // The frame of reference of the 8 elements of the current slot
+        __m256i frame = _mm256_add_epi32(_mm256_set1_epi32(block.base), _mm256_mullo_epi32(_mm256_set1_epi32(block.slope), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+        const __m256i slotStep = _mm256_set1_epi32(block.slope * LANES);
+        const __m256i offsetMask = _mm256_set1_epi32(mask(block.width));
+        const std::uint32_t *lanes = allWords + block.firstWord;
+        for (int slot = 0; slot < SLOTS; slot++)
+        {
+            const int bit = slot * block.width;
+            const int shift = bit % 32;
+            const std::uint32_t *word = lanes + bit / 32 * LANES;
+
+            __m256i offsets = block.width == 0 ? _mm256_setzero_si256() : _mm256_srl_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(word)), _mm_cvtsi32_si128(shift));
+            if (shift + block.width > 32)
+            {
+                const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(word + LANES));
+                offsets = _mm256_or_si256(offsets, _mm256_sll_epi32(next, _mm_cvtsi32_si128(32 - shift)));
+            }
+
+            const __m256i elements = _mm256_add_epi32(frame, _mm256_and_si256(offsets, offsetMask));
+            frame = _mm256_add_epi32(frame, slotStep);
+            if constexpr (sizeof(T) == 4)
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + slot * LANES), elements);
+            else
+            {
+                alignas(32) std::uint32_t decoded[LANES];
+                _mm256_store_si256(reinterpret_cast<__m256i *>(decoded), elements);
+                for (int lane = 0; lane < LANES; lane++)
+                    output[slot * LANES + lane] = static_cast<T>(decoded[lane]);
+            }
+        }
+    }
+#endif
+
+    void encodeBlock(span<const T> elements)
+    {
+        // The offsets from the line through the first and last elements, or from 0 if they take fewer bits
+        const long long lineSlope = (static_cast<long long>(elements.back()) - elements.front()) / (BLOCK_SIZE - 1);
+        auto residualRange = [elements](long long slope)
+        {
+            long long smallest = elements[0], largest = elements[0];
+            for (int index = 1; index < BLOCK_SIZE; index++)
+            {
+                const long long residual = elements[index] - index * slope;
+                smallest = std::min(smallest, residual);
+                largest = std::max(largest, residual);
+            }
+            return std::pair(smallest, largest - smallest);
+        };
+
+        auto [base, range] = residualRange(0);
+        long long slope = 0;
+        if (auto [lineBase, lineRange] = residualRange(lineSlope); lineRange < range)
+        {
+            base = lineBase;
+            range = lineRange;
+            slope = lineSlope;
+        }
+
+        const int width = range == 0 ? 0 : 64 - __builtin_clzll(range);
+        const size_t firstWord = words.size();
+        // Every lane takes SLOTS * width bits, a whole number of words
+        words.resize(firstWord + SLOTS * width / 32 * LANES);
+
+        for (int index = 0; index < BLOCK_SIZE && width > 0; index++)
+        {
+            const Offset offset = static_cast<Offset>(elements[index] - index * slope - base);
+            const size_t bit = index / LANES * width;
+            const size_t word = firstWord + bit / 32 * LANES + index % LANES;
+            const int shift = bit % 32;
+            words[word] |= offset << shift;
+            if (shift + width > 32)
+                words[word + LANES] |= offset >> (32 - shift);
+        }
+
+        blocks.push_back(Block{static_cast<Offset>(base), static_cast<Offset>(slope), static_cast<std::uint32_t>(firstWord), static_cast<std::uint8_t>(width)});
+        firstElements.push_back(elements.front());
+    }
+
+    void clear()
+    {
+        words.clear();
+        blocks.clear();
+        firstElements.clear();
+        tail.clear();
+    }
+
+    vector<T> decodeAll() const
+    {
+        vector<T> values(size());
+        for (size_t block = 0; block < blocks.size(); block++)
+            decodeBlock(block, values.data() + block * BLOCK_SIZE);
+        std::copy(tail.begin(), tail.end(), values.begin() + blocks.size() * BLOCK_SIZE);
+        return values;
+    }
+
+    /// Removes the blocks from <<firstBlock>> on and appends their elements again, one block decoded
+    /// at a time. <<keep>>(position, element, output) tells whether to keep the element, and may
+    /// append other values before it by calling output(value).
+    template <class Keep>
+    void rebuildFrom(size_t firstBlock, Keep keep)
+    {
+        firstBlock = std::min(firstBlock, blocks.size());
+        const size_t firstWord = firstBlock < blocks.size() ? blocks[firstBlock].firstWord : words.size();
+        const vector<std::uint32_t> oldWords(words.begin() + firstWord, words.end());
+        const vector<Block> oldBlocks(blocks.begin() + firstBlock, blocks.end());
+        const vector<T> oldTail = move(tail);
+
+        words.resize(firstWord);
+        blocks.resize(firstBlock);
+        firstElements.resize(firstBlock);
+        tail.clear();
+
+        auto output = [this](const T &value)
+        { push_back(value); };
+        size_t position = firstBlock * BLOCK_SIZE;
+        std::array<T, BLOCK_SIZE> decoded;
+        for (Block block : oldBlocks)
+        {
+            block.firstWord -= firstWord;
+            decode(oldWords.data(), block, decoded.data());
+            for (const T &element : decoded)
+                if (keep(position++, element, output))
+                    push_back(element);
+        }
+
+        for (const T &element : oldTail)
+            if (keep(position++, element, output))
+                push_back(element);
+    }
+
+    vector<std::uint32_t> words;
+    vector<Block> blocks;
+    /// Skip index: the first element of every block
+    vector<T> firstElements;
+    vector<T> tail;
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include "ExtendedVector.h"
+#include "ReadEpochs.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+using std::move;
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// ExtendedVector shared by many reader threads and a few writers. Readers search an immutable
+/// version of the container, a snapshot, which they get without locks or waiting: the version is an
+/// atomic pointer and ReadEpochs keeps it alive while they use it. Writers queue their changes;
+/// publish() applies them to a copy of the current version and swaps it in, so readers only see the
+/// changes once published, all at once. Copying costs O(n), so changes should be published in
+/// batches: publish() is called by the writer every <<publishEvery>> changes, or explicitly.
+template <class T, class Storage = VectorStorage<T>>
+class ConcurrentExtendedVector
+{
+
+public:
+    using Version = ExtendedVector<T, Storage>;
+
+    /// A version of the container that stays valid, and unchanged, until the snapshot is destroyed.
+    class Snapshot
+    {
+
+    public:
+        Snapshot(const std::atomic<const Version *> &current)
+        {
+            ReadEpochs::enter();
+            version = current.load();
+        }
+
+        Snapshot(const Snapshot &) = delete;
+        Snapshot &operator=(const Snapshot &) = delete;
+        ~Snapshot() { ReadEpochs::leave(); }
+
+        const Version &operator*() const { return *version; }
+        const Version *operator->() const { return version; }
+
+    private:
+        const Version *version;
+    };
+
+    ConcurrentExtendedVector(Version &&initial, size_t publishEveryParam = 1024)
+        : current(prepared(new Version(move(initial)))), publishEvery(publishEveryParam) {}
+
+    /// Bulk construction, as the ExtendedVector constructor with the same arguments.
+    ConcurrentExtendedVector(vector<T> &&input, BuildOrder order = SORT, SearchMode mode = BINARY_SEARCH,
+                             size_t publishEveryParam = 1024)
+        : current(prepared(new Version(move(input), order, mode))), publishEvery(publishEveryParam) {}
+
+    ConcurrentExtendedVector(const ConcurrentExtendedVector &) = delete;
+    ConcurrentExtendedVector &operator=(const ConcurrentExtendedVector &) = delete;
+
+    /// There must be no snapshot left.
+    ~ConcurrentExtendedVector()
+    {
+        delete current.load();
+        for (auto &[version, epoch] : retired)
+            delete version;
+    }
+
+    /// Never blocks: readers only announce their epoch and read the current version.
+    Snapshot snapshot() const { return Snapshot(current); }
+
+    int find(const T &value) const
+    {
+        Snapshot version = snapshot();
+        return version->find(value);
+    }
+
+    bool contains(const T &value) const
+    {
+        Snapshot version = snapshot();
+        return version->contains(value);
+    }
+
+    size_t count() const
+    {
+        Snapshot version = snapshot();
+        return version->count();
+    }
+
+    /// Queued until the next publish().
+    void insert(const T &value) { change(value, true); }
+
+    /// Queued until the next publish().
+    void removeFirstFound(const T &value) { change(value, false); }
+
+    /// Applies the queued changes, then <<modify>> (e.g. [](Version &version) { version.setSearchMode(...); }),
+    /// to a copy of the current version, and makes it the current one.
+    template <class Function>
+    void update(Function modify)
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        Version *version = new Version(*current.load());
+        applyPending(*version);
+        modify(*version);
+        publishVersion(version);
+    }
+
+    void publish()
+    {
+        update([](Version &) {});
+    }
+
+    /// Changes waiting for publish().
+    size_t pendingCount() const
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        return pending.size();
+    }
+
+    /// Replaced versions that may still be read by a snapshot, so they are not deleted yet.
+    size_t retiredCount() const
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        return retired.size();
+    }
+
+private:
+    struct Change
+    {
+        T value;
+        bool insertion;
+    };
+
+    /// Searches on the version must not build anything lazily, as it is read by several threads.
+    static const Version *prepared(Version *version)
+    {
+        version->prepareSearches();
+        return version;
+    }
+
+    void change(const T &value, bool insertion)
+    {
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            pending.push_back(Change{value, insertion});
+            if (pending.size() < publishEvery)
+                return;
+        }
+
+        publish();
+    }
+
+    /// Applies the changes in order, with the consecutive insertions in one batch.
+    void applyPending(Version &version)
+    {
+        vector<T> insertions;
+        for (Change &change : pending)
+        {
+            if (change.insertion)
+            {
+                insertions.push_back(move(change.value));
+                continue;
+            }
+
+            version.insertBatch(span<const T>(insertions));
+            insertions.clear();
+            version.removeFirstFound(move(change.value));
+        }
+
+        version.insertBatch(span<const T>(insertions));
+        pending.clear();
+    }
+
+    void publishVersion(Version *version)
+    {
+        prepared(version);
+        const Version *previous = current.exchange(version);
+        retired.emplace_back(previous, ReadEpochs::retireEpoch());
+
+        // Delete the versions no reader can see any more
+        const std::uint64_t oldest = ReadEpochs::oldestReader();
+        std::erase_if(retired, [oldest](const std::pair<const Version *, std::uint64_t> &entry)
+                      {
+                          if (entry.second >= oldest)
+                              return false;
+                          delete entry.first;
+                          return true;
+                      });
+    }
+
+    std::atomic<const Version *> current;
+    size_t publishEvery;
+    mutable std::mutex writerMutex;
+    vector<Change> pending;
+    /// Replaced versions with the epoch at which they were retired
+    vector<std::pair<const Version *, std::uint64_t>> retired;
+};
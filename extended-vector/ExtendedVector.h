@@ -0,0 +1,437 @@
+#pragma once
+#include "EytzingerLayout.h"
+#include "KAryLayout.h"
+#include "LearnedIndex.h"
+#include "VectorStorage.h"
+#include "ParallelSort.h"
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <type_traits>
+using std::move;
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// How ExtendedVector::find looks for a value. All of them assume the container is sorted.
+enum SearchMode
+{
+    /// The recursive binarySearch
+    BINARY_SEARCH,
+    /// Iterative branchless lower bound over the container
+    BRANCHLESS_SEARCH,
+    /// Iterative branchless lower bound over a copy of the container in Eytzinger order, rebuilt on
+    /// the first search after a change. It doubles the memory, so it is meant for read-mostly data.
+    EYTZINGER_SEARCH,
+    /// Lower bound over a copy of the container in a KAryLayout, rebuilt on the first search after a
+    /// change: SIMD comparisons of a whole cache line per step for arithmetic types, the same as
+    /// EYTZINGER_SEARCH for the other ones.
+    KARY_SEARCH,
+    /// Bounded search around the position predicted by a LearnedIndex of the container, rebuilt on
+    /// the first search after a change. For numeric keys close to uniform; when the model does not
+    /// fit (or the type is not numeric) it falls back to BINARY_SEARCH.
+    LEARNED_SEARCH
+};
+
+/// What ExtendedVector::insert does with the new elements.
+enum InsertMode
+{
+    /// Appends them, as given
+    APPEND,
+    /// Keeps the container sorted. Batches are sorted and merged with the container; single elements
+    /// wait in a small sorted buffer merged once it is full or before a search by position.
+    SORTED_INSERT
+};
+
+/// What the bulk constructor of ExtendedVector does with the order of the given elements.
+enum BuildOrder
+{
+    KEEP_ORDER,
+    SORT,
+    /// Sorts and removes the duplicates
+    SORT_UNIQUE
+};
+
+/// <<Storage>> holds the elements: a VectorStorage by default, a SmallVectorStorage, which keeps small
+/// containers inside the object, a ChunkedStorage, whose insertions and removals only move the
+/// elements of one chunk, for large containers that change often, or a CompressedStorage, which
+/// bit-packs large sets of integers close together. The allocator of the storage, if it
+/// has one, is given by the constructors taking std::allocator_arg.
+template <class T, class Storage = VectorStorage<T>>
+class ExtendedVector
+{
+
+public:
+    using const_iterator = typename Storage::const_iterator;
+
+    ExtendedVector() = delete;
+    ExtendedVector(const vector<T> &input)
+    {
+        container.append(span<const T>(input));
+    }
+
+    /// Takes the elements over instead of copying them (with the default storage).
+    ExtendedVector(vector<T> &&input)
+    {
+        container.assign(move(input));
+    }
+
+    /// Bulk construction: sorts (and deduplicates) <<input>> on <<threadCount>> threads, takes it over
+    /// and builds the search layout of <<mode>> right away, so the first search does not pay for it.
+    /// Sorted containers start in SORTED_INSERT mode.
+    ExtendedVector(vector<T> &&input, BuildOrder order, SearchMode mode = BINARY_SEARCH,
+                   int threadCount = std::thread::hardware_concurrency())
+        : insertMode(order == KEEP_ORDER ? APPEND : SORTED_INSERT), searchMode(mode)
+    {
+        if (order != KEEP_ORDER)
+            parallelSort(input, order == SORT_UNIQUE, threadCount);
+
+        container.assign(move(input));
+        prepareSearches();
+    }
+
+    template <class... Ts>
+    ExtendedVector(Ts... elements)
+    {
+        container.reserve(sizeof...(Ts));
+        (container.push_back(elements), ...);
+    }
+
+    template <class Allocator>
+        requires std::is_constructible_v<Storage, const Allocator &>
+    ExtendedVector(std::allocator_arg_t, const Allocator &allocator, const vector<T> &input) : container(allocator)
+    {
+        container.append(span<const T>(input));
+    }
+
+    template <class Allocator, class... Ts>
+        requires std::is_constructible_v<Storage, const Allocator &>
+    ExtendedVector(std::allocator_arg_t, const Allocator &allocator, Ts... elements) : container(allocator)
+    {
+        container.reserve(sizeof...(Ts));
+        (container.push_back(elements), ...);
+    }
+
+    ExtendedVector(const ExtendedVector &) = default;
+    ExtendedVector(ExtendedVector &&) = default;
+    ExtendedVector &operator=(const ExtendedVector &) = default;
+    ExtendedVector &operator=(ExtendedVector &&) = default;
+
+    /// Virtual like the searches, since mocks and other derived classes may be deleted through an ExtendedVector.
+    virtual ~ExtendedVector() = default;
+
+    /// Elements waiting in the insertion buffer before being merged in SORTED_INSERT mode.
+    static constexpr size_t INSERTION_BUFFER_SIZE = 64;
+
+    /// The elements are appended (or merged) all at once, so the storage grows at most once.
+    template <class... Ts>
+    void insert(Ts... elements)
+    {
+        if constexpr (sizeof...(Ts) == 1)
+        {
+            if (insertMode == SORTED_INSERT)
+            {
+                (bufferInsert(elements), ...);
+                return;
+            }
+        }
+
+        if constexpr (sizeof...(Ts) > 0)
+        {
+            T batch[] = {T(elements)...};
+            if (insertMode == SORTED_INSERT)
+            {
+                // Sorted in place, without going through the scratch vector of insertBatch
+                std::sort(std::begin(batch), std::end(batch));
+                container.mergeSorted(span<const T>(batch));
+                changed();
+            }
+            else
+                insertBatch(span<const T>(batch));
+        }
+    }
+
+    /// Same as insert(values...). In SORTED_INSERT mode the batch is sorted and merged with the
+    /// container in O(n + k log k), with at most one reallocation.
+    void insertBatch(span<const T> values)
+    {
+        if (insertMode == APPEND)
+            container.append(values);
+        else
+        {
+            scratch.assign(values.begin(), values.end());
+            std::sort(scratch.begin(), scratch.end());
+            container.mergeSorted(span<const T>(scratch));
+        }
+
+        changed();
+    }
+
+    /// Switching to SORTED_INSERT sorts the container once.
+    void setInsertMode(InsertMode mode)
+    {
+        if (mode == SORTED_INSERT && insertMode == APPEND)
+        {
+            container.sort();
+            changed();
+        }
+        else if (mode == APPEND)
+            mergeBuffer();
+
+        insertMode = mode;
+    }
+
+    InsertMode getInsertMode() const { return insertMode; }
+
+    virtual size_t count() const
+    {
+        return container.size() + buffer.size();
+    }
+
+    /// Whether an element equal to <<value>> is stored, looking in the insertion buffer without merging it.
+    bool contains(const T &value) const
+    {
+        if (std::binary_search(buffer.begin(), buffer.end(), value))
+            return true;
+        if (container.empty())
+            return false;
+
+        return foundIndex(containerLowerBound(value), value) >= 0;
+    }
+
+    /// Positions refer to the container with the insertion buffer merged.
+    virtual int binarySearch(int start, int end, T &&value) const
+    {
+        mergeBuffer();
+        if (start == end)
+            return container[start] == value ? start : -1;
+
+        int middle = (start + end) / 2;
+
+        if (container[middle] == value)
+            return middle;
+        if (container[middle] > value)
+            return binarySearch(start, middle, move(value));
+
+        return binarySearch(middle + 1, end, move(value));
+    }
+
+    void setSearchMode(SearchMode mode) { searchMode = mode; }
+    SearchMode getSearchMode() const { return searchMode; }
+
+    /// Merges the insertion buffer and builds the layout of the search mode. Until the next change the
+    /// const members then only read, so they can be called from several threads at once.
+    void prepareSearches() const
+    {
+        mergeBuffer();
+        if (searchMode == EYTZINGER_SEARCH)
+            layout();
+        else if (searchMode == KARY_SEARCH)
+            karyLayout();
+        else if (searchMode == LEARNED_SEARCH)
+            learnedModel();
+    }
+
+    /// Position of the first element not less than <<value>> (count() if there is none).
+    int lowerBound(const T &value) const
+    {
+        mergeBuffer();
+        return containerLowerBound(value);
+    }
+
+    /// Index of an element equal to <<value>>, or -1, as binarySearch(0, count() - 1, value) but with
+    /// the current search mode. Except in BINARY_SEARCH mode it is the first of the equal elements.
+    int find(const T &value) const
+    {
+        mergeBuffer();
+        if (container.empty())
+            return -1;
+        if (searchMode == BINARY_SEARCH || (searchMode == LEARNED_SEARCH && !learnedModel().fits()))
+            return binarySearch(0, container.size() - 1, T(value));
+
+        return foundIndex(lowerBound(value), value);
+    }
+
+    /// find of every value. In EYTZINGER_SEARCH mode the lookups are interleaved so that their cache
+    /// misses overlap, which pays off from a few thousand elements on.
+    void find(span<const T> values, span<int> indices) const
+    {
+        mergeBuffer();
+        if (searchMode != EYTZINGER_SEARCH && searchMode != KARY_SEARCH)
+        {
+            for (size_t i = 0; i < values.size(); i++)
+                indices[i] = find(values[i]);
+            return;
+        }
+
+        if (searchMode == EYTZINGER_SEARCH)
+            layout().lowerBound(values, indices);
+        else
+            karyLayout().lowerBound(values, indices);
+        for (size_t i = 0; i < values.size(); i++)
+            indices[i] = foundIndex(indices[i], values[i]);
+    }
+
+    vector<int> find(span<const T> values) const
+    {
+        vector<int> indices(values.size());
+        find(values, span<int>(indices));
+        return indices;
+    }
+
+    /// In order iteration, with the insertion buffer merged.
+    const_iterator begin() const
+    {
+        mergeBuffer();
+        return container.begin();
+    }
+
+    const_iterator end() const
+    {
+        mergeBuffer();
+        return container.end();
+    }
+
+    /// The model of LEARNED_SEARCH, built from the current elements, e.g. to check fits() and maximumError().
+    const LearnedIndex<T> &learnedIndex() const
+    {
+        mergeBuffer();
+        return learnedModel();
+    }
+
+    const Storage &storage() const
+    {
+        mergeBuffer();
+        return container;
+    }
+
+    void removeFirstFound(T &&value)
+    {
+        auto buffered = std::lower_bound(buffer.begin(), buffer.end(), value);
+        if (buffered != buffer.end() && *buffered == value)
+        {
+            buffer.erase(buffered);
+            return;
+        }
+
+        int index = find(value);
+
+        if (index < 0)
+            return;
+
+        container.eraseAt(index);
+        changed();
+    }
+
+private:
+    int containerLowerBound(const T &value) const
+    {
+        if (searchMode == EYTZINGER_SEARCH)
+            return layout().lowerBound(value);
+        if (searchMode == KARY_SEARCH)
+            return karyLayout().lowerBound(value);
+        if (searchMode == LEARNED_SEARCH && learnedModel().fits())
+        {
+            if constexpr (Storage::CONTIGUOUS)
+                return learned.lowerBound(container.view(), container.size(), value);
+            else
+                return learned.lowerBound(container, container.size(), value);
+        }
+
+        return container.lowerBound(value);
+    }
+
+    void changed() const { layoutOutdated = karyLayoutOutdated = learnedOutdated = true; }
+
+    void bufferInsert(const T &value)
+    {
+        // Merging into a small container is as cheap as buffering, and does not allocate a buffer
+        if (container.size() < INSERTION_BUFFER_SIZE && buffer.empty())
+        {
+            container.mergeSorted(span<const T>(&value, 1));
+            changed();
+            return;
+        }
+
+        buffer.insert(std::upper_bound(buffer.begin(), buffer.end(), value), value);
+        if (buffer.size() >= INSERTION_BUFFER_SIZE)
+            mergeBuffer();
+    }
+
+    void mergeBuffer() const
+    {
+        if (buffer.empty())
+            return;
+
+        container.mergeSorted(span<const T>(buffer));
+        buffer.clear();
+        changed();
+    }
+
+    /// Builds a search layout from the sorted elements, copied first when the storage is not contiguous.
+    template <class Layout>
+    void buildLayout(Layout &layout) const
+    {
+        if constexpr (Storage::CONTIGUOUS)
+            layout.build(container.view());
+        else
+        {
+            const vector<T> values(container.begin(), container.end());
+            layout.build(span<const T>(values));
+        }
+    }
+
+    int foundIndex(int position, const T &value) const
+    {
+        return position >= 0 && static_cast<size_t>(position) < container.size() && container[position] == value ? position : -1;
+    }
+
+    const EytzingerLayout<T> &layout() const
+    {
+        if (layoutOutdated)
+        {
+            buildLayout(eytzinger);
+            layoutOutdated = false;
+        }
+
+        return eytzinger;
+    }
+
+    const KAryLayout<T> &karyLayout() const
+    {
+        if (karyLayoutOutdated)
+        {
+            buildLayout(kary);
+            karyLayoutOutdated = false;
+        }
+
+        return kary;
+    }
+
+    const LearnedIndex<T> &learnedModel() const
+    {
+        if (learnedOutdated)
+        {
+            buildLayout(learned);
+            learnedOutdated = false;
+        }
+
+        return learned;
+    }
+
+    /// Mutable so that searches by position can merge the insertion buffer
+    mutable Storage container;
+    mutable vector<T> buffer;
+    vector<T> scratch;
+    InsertMode insertMode{APPEND};
+    SearchMode searchMode{BINARY_SEARCH};
+    mutable EytzingerLayout<T> eytzinger;
+    mutable bool layoutOutdated{true};
+    mutable KAryLayout<T> kary;
+    mutable bool karyLayoutOutdated{true};
+    mutable LearnedIndex<T> learned;
+    mutable bool learnedOutdated{true};
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <algorithm>
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// Position of the first element of <<sorted>> not less than <<value>> (sorted.size() if there is none).
+/// Iterative and branchless: every step halves the range with a conditional move instead of a jump,
+/// so there is nothing to mispredict and the number of steps only depends on the size.
+template <class T>
+int branchlessLowerBound(span<const T> sorted, const T &value)
+{
+    if (sorted.empty())
+        return 0;
+
+    const T *base = sorted.data();
+    size_t length = sorted.size();
+    while (length > 1)
+    {
+        const size_t half = length / 2;
+        base += base[half - 1] < value ? half : 0;
+        length -= half;
+    }
+
+    return base - sorted.data() + (*base < value);
+}
+
+/// Copy of sorted values in Eytzinger (breadth first) order: the root at index 1 and the children of
+/// node k at 2k and 2k + 1. The first levels, visited by every search, share a few cache lines, and
+/// the nodes a search visits next are at known places, so they are prefetched a few levels ahead
+/// instead of missing the cache one level at a time as a binary search over the sorted values does.
+template <class T>
+class EytzingerLayout
+{
+
+public:
+    /// Nodes of the same level fetched in one cache line, i.e. prefetched four levels ahead for ints.
+    static constexpr size_t PREFETCH_DISTANCE = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+    /// Lookups interleaved by the batch lowerBound.
+    static constexpr int BATCH_SIZE = 16;
+
+    EytzingerLayout() = default;
+    EytzingerLayout(span<const T> sorted) { build(sorted); }
+
+    /// Rebuilds the layout from sorted values in O(n).
+    void build(span<const T> sorted)
+    {
+        tree.resize(sorted.size() + 1);
+        ranks.resize(sorted.size() + 1);
+        ranks[0] = sorted.size();
+
+        int rank = 0;
+        fill(sorted, rank, 1);
+    }
+
+    int size() const { return tree.size() - 1; }
+
+    /// Same result as branchlessLowerBound over the values the layout was built from.
+    int lowerBound(const T &value) const
+    {
+        const size_t size = tree.size() - 1;
+        const T *nodes = tree.data();
+        size_t node = 1;
+
+        while (node <= size)
+        {
+            __builtin_prefetch(nodes + node * PREFETCH_DISTANCE);
+            node = 2 * node + (nodes[node] < value);
+        }
+
+        // The right turns taken after the last left one lead out of the answer's subtree: undo them
+        node >>= __builtin_ffsll(~node);
+        return ranks[node];
+    }
+
+    /// lowerBound of every value, with BATCH_SIZE searches advanced one level at a time so that their
+    /// cache misses overlap instead of being paid one after the other.
+    void lowerBound(span<const T> values, span<int> positions) const
+    {
+        const size_t size = tree.size() - 1;
+        const T *nodes = tree.data();
+        size_t batchNodes[BATCH_SIZE];
+
+        for (size_t first = 0; first < values.size(); first += BATCH_SIZE)
+        {
+            const int count = std::min<size_t>(BATCH_SIZE, values.size() - first);
+            for (int lane = 0; lane < count; lane++)
+                batchNodes[lane] = 1;
+
+            for (bool descending = size > 0; descending;)
+            {
+                descending = false;
+                for (int lane = 0; lane < count; lane++)
+                {
+                    size_t &node = batchNodes[lane];
+                    if (node > size)
+                        continue;
+
+                    __builtin_prefetch(nodes + node * PREFETCH_DISTANCE);
+                    node = 2 * node + (nodes[node] < values[first + lane]);
+                    descending = true;
+                }
+            }
+
+            for (int lane = 0; lane < count; lane++)
+                positions[first + lane] = ranks[batchNodes[lane] >> __builtin_ffsll(~batchNodes[lane])];
+        }
+    }
+
+private:
+    /// In-order traversal of the implicit tree, so the nodes receive the sorted values in order.
+    void fill(span<const T> sorted, int &rank, size_t node)
+    {
+        if (node > sorted.size())
+            return;
+
+        fill(sorted, rank, 2 * node);
+        tree[node] = sorted[rank];
+        ranks[node] = rank++;
+        fill(sorted, rank, 2 * node + 1);
+    }
+
+    /// tree[0] and ranks[0] are sentinels: ranks[0] is the position past the last value.
+    vector<T> tree;
+    vector<int> ranks;
+};
@@ -0,0 +1,228 @@
+#pragma once
+#include "EytzingerLayout.h"
+#include <vector>
+#include <span>
+#include <memory>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+using std::size_t;
+using std::span;
+using std::unique_ptr;
+using std::vector;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KARY_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+/// Node comparisons of the k-ary search layout. The scalar version is a fixed size loop that the
+/// compiler vectorizes with the baseline instruction set; the AVX2 one compares a whole node (one
+/// cache line) with two instructions. countLess picks the AVX2 version at runtime when the processor
+/// supports it.
+namespace KAryKernels
+{
+    inline bool avx2Supported()
+    {
+#ifdef KARY_AVX2_KERNELS
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    namespace scalar
+    {
+        /// Number of the <<B>> keys smaller than <<value>>.
+        template <class T, int B>
+        int countLess(const T *keys, T value)
+        {
+            int count = 0;
+            for (int i = 0; i < B; i++)
+                count += keys[i] < value;
+
+            return count;
+        }
+    }
+
+#ifdef KARY_AVX2_KERNELS
+    /// Whether there is an AVX2 kernel for the keys of type T.
+    template <class T>
+    constexpr bool hasAvx2Kernel = std::is_same_v<T, float> || std::is_same_v<T, double> ||
+                                   (std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) == 4 || sizeof(T) == 8));
+
+    namespace avx2
+    {
+        /// Same as scalar::countLess for a node of exactly one cache line.
+        template <class T, int B>
+        __attribute__((target("avx2,popcnt"))) int countLess(const T *keys, T value)
+        {
+            static_assert(B * sizeof(T) == 64);
+            int mask;
+
+            if constexpr (std::is_same_v<T, float>)
+            {
+                const __m256 broadcast = _mm256_set1_ps(value);
+                const int low = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(keys), broadcast, _CMP_LT_OQ));
+                const int high = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(keys + 8), broadcast, _CMP_LT_OQ));
+                mask = low | high << 8;
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                const __m256d broadcast = _mm256_set1_pd(value);
+                const int low = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_load_pd(keys), broadcast, _CMP_LT_OQ));
+                const int high = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_load_pd(keys + 4), broadcast, _CMP_LT_OQ));
+                mask = low | high << 4;
+            }
+            else if constexpr (sizeof(T) == 4)
+            {
+                const __m256i broadcast = _mm256_set1_epi32(value);
+                const __m256i low = _mm256_cmpgt_epi32(broadcast, _mm256_load_si256(reinterpret_cast<const __m256i *>(keys)));
+                const __m256i high = _mm256_cmpgt_epi32(broadcast, _mm256_load_si256(reinterpret_cast<const __m256i *>(keys + 8)));
+                mask = _mm256_movemask_ps(_mm256_castsi256_ps(low)) | _mm256_movemask_ps(_mm256_castsi256_ps(high)) << 8;
+            }
+            else
+            {
+                const __m256i broadcast = _mm256_set1_epi64x(value);
+                const __m256i low = _mm256_cmpgt_epi64(broadcast, _mm256_load_si256(reinterpret_cast<const __m256i *>(keys)));
+                const __m256i high = _mm256_cmpgt_epi64(broadcast, _mm256_load_si256(reinterpret_cast<const __m256i *>(keys + 4)));
+                mask = _mm256_movemask_pd(_mm256_castsi256_pd(low)) | _mm256_movemask_pd(_mm256_castsi256_pd(high)) << 4;
+            }
+
+            return __builtin_popcount(mask);
+        }
+    }
+#endif
+}
+
+/// Search layout for the values of a sorted container, selected at compile time: a k-ary search tree
+/// compared with SIMD instructions for arithmetic types, an EytzingerLayout for any other type.
+template <class T, bool = std::is_arithmetic_v<T>>
+class KAryLayout : public EytzingerLayout<T>
+{
+
+public:
+    KAryLayout() = default;
+    KAryLayout(span<const T> sorted) : EytzingerLayout<T>(sorted) {}
+};
+
+/// Static search tree (a B-tree without pointers) whose nodes hold the B = 64 / sizeof(T) keys of one
+/// cache line and have B + 1 children: node k has the children k * (B + 1) + i + 1. A lookup compares
+/// the value with a whole node at once and visits log_(B+1)(n) nodes, about four times fewer than the
+/// binary search for 4 byte keys, each in a single cache line. The last node is padded with
+/// PADDING, which no value is greater than.
+template <class T>
+class KAryLayout<T, true>
+{
+
+public:
+    static constexpr int B = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+    static constexpr size_t CACHE_LINE = 64;
+    /// Infinity for floating point keys: the largest finite value would be less than an infinite one
+    static constexpr T PADDING = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+
+    KAryLayout() = default;
+    KAryLayout(span<const T> sorted) { build(sorted); }
+    KAryLayout(KAryLayout &&) = default;
+    KAryLayout &operator=(KAryLayout &&) = default;
+
+    KAryLayout(const KAryLayout &other) : valueCount(other.valueCount), nodeCount(other.nodeCount), ranks(other.ranks)
+    {
+        if (other.keys)
+        {
+            allocateKeys();
+            std::copy(other.keys.get(), other.keys.get() + nodeCount * B, keys.get());
+        }
+    }
+
+    KAryLayout &operator=(const KAryLayout &other)
+    {
+        KAryLayout copy(other);
+        return *this = std::move(copy);
+    }
+
+    /// Rebuilds the layout from sorted values in O(n).
+    void build(span<const T> sorted)
+    {
+        valueCount = sorted.size();
+        nodeCount = (sorted.size() + B - 1) / B;
+        allocateKeys();
+        ranks.resize(nodeCount * B);
+
+        size_t rank = 0;
+        fill(sorted, rank, 0);
+    }
+
+    int size() const { return valueCount; }
+
+    /// Position of the first value not less than <<value>> (size() if there is none).
+    int lowerBound(const T &value) const
+    {
+#ifdef KARY_AVX2_KERNELS
+        if constexpr (KAryKernels::hasAvx2Kernel<T> && B * sizeof(T) == CACHE_LINE)
+            if (KAryKernels::avx2Supported())
+                return search<KAryKernels::avx2::countLess<T, B>>(value);
+#endif
+        return search<KAryKernels::scalar::countLess<T, B>>(value);
+    }
+
+    void lowerBound(span<const T> values, span<int> positions) const
+    {
+        for (size_t i = 0; i < values.size(); i++)
+            positions[i] = lowerBound(values[i]);
+    }
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(T *data) const { ::operator delete(data, std::align_val_t(CACHE_LINE)); }
+    };
+
+    void allocateKeys()
+    {
+        keys.reset(static_cast<T *>(::operator new(std::max<size_t>(nodeCount, 1) * B * sizeof(T), std::align_val_t(CACHE_LINE))));
+    }
+
+    static size_t child(size_t node, int i) { return node * (B + 1) + i + 1; }
+
+    template <int (*countLess)(const T *, T)>
+    int search(T value) const
+    {
+        int position = valueCount;
+        size_t node = 0;
+
+        while (node < nodeCount)
+        {
+            const int i = countLess(keys.get() + node * B, value);
+            if (i < B)
+                position = ranks[node * B + i];
+            node = child(node, i);
+        }
+
+        return position;
+    }
+
+    /// In-order traversal of the implicit tree, so the key slots receive the sorted values in order.
+    void fill(span<const T> sorted, size_t &rank, size_t node)
+    {
+        if (node >= nodeCount)
+            return;
+
+        for (int i = 0; i < B; i++)
+        {
+            fill(sorted, rank, child(node, i));
+            keys[node * B + i] = rank < sorted.size() ? sorted[rank] : PADDING;
+            ranks[node * B + i] = std::min(rank, sorted.size());
+            rank++;
+        }
+        fill(sorted, rank, child(node, B));
+    }
+
+    size_t valueCount{};
+    size_t nodeCount{};
+    unique_ptr<T[], AlignedDelete> keys;
+    vector<int> ranks;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+#include "EytzingerLayout.h"
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// Model of the position of a key in sorted numeric data, a small learned index: the keys are cut in
+/// segments of SEGMENT_SIZE keys and each segment predicts positions by linear interpolation between
+/// its first and its last key. The largest distance between the predicted and the real position of
+/// a key of the segment is measured at build time, so a lookup only searches the few keys around the
+/// prediction. Nearly uniform keys need a window of a few keys instead of log2(n) steps.
+/// For non numeric types the model never fits (fits() is false).
+template <class T, bool = std::is_arithmetic_v<T>>
+class LearnedIndex
+{
+
+public:
+    void build(span<const T>) {}
+    bool fits() const { return false; }
+    int maximumError() const { return 0; }
+
+    template <class Keys>
+    int lowerBound(const Keys &, int, const T &) const { return 0; }
+};
+
+template <class T>
+class LearnedIndex<T, true>
+{
+
+public:
+    static constexpr int SEGMENT_SIZE = 256;
+    /// Above this error the windows are so wide that a binary search is as fast: the model does not fit.
+    static constexpr int MAXIMUM_USEFUL_ERROR = 64;
+
+    /// Fits the model to sorted keys in O(n).
+    void build(span<const T> sorted)
+    {
+        const size_t segmentCount = (sorted.size() + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+        segments.resize(segmentCount);
+        firstKeys.resize(segmentCount);
+        maximumErrorValue = 0;
+
+        for (size_t segment = 0; segment < segmentCount; segment++)
+        {
+            const size_t first = segment * SEGMENT_SIZE;
+            const size_t last = std::min(sorted.size(), first + SEGMENT_SIZE) - 1;
+            const double keyRange = static_cast<double>(sorted[last]) - static_cast<double>(sorted[first]);
+
+            Segment &model = segments[segment];
+            model.firstKey = sorted[first];
+            model.slope = keyRange > 0 ? (last - first) / keyRange : 0;
+            model.firstPosition = first;
+            firstKeys[segment] = sorted[first];
+
+            double error = 0;
+            for (size_t position = first; position <= last; position++)
+                error = std::max(error, std::abs(predict(model, sorted[position]) - position));
+
+            // One more position for the rounding of the predictions
+            model.error = static_cast<int>(std::ceil(error)) + 1;
+            maximumErrorValue = std::max(maximumErrorValue, model.error);
+        }
+    }
+
+    /// Whether the model predicts the positions well enough to be used instead of a binary search.
+    bool fits() const { return !segments.empty() && maximumErrorValue <= MAXIMUM_USEFUL_ERROR; }
+
+    /// Largest distance between a predicted and a real position, rounded up.
+    int maximumError() const { return maximumErrorValue; }
+
+    /// Position of the first of the <<size>> sorted <<keys>> (the ones the model was built from, with
+    /// an operator[]) not less than <<value>>.
+    template <class Keys>
+    int lowerBound(const Keys &keys, int size, const T &value) const
+    {
+        // The last segment whose first key is smaller than the value: the answer is after its first key
+        const int segment = branchlessLowerBound(span<const T>(firstKeys), value) - 1;
+        if (segment < 0)
+            return 0;
+
+        const Segment &model = segments[segment];
+        const int segmentEnd = std::min<int>(size, model.firstPosition + SEGMENT_SIZE);
+        const double prediction = predict(model, value);
+        // The keys around the answer are at most model.error positions away from their predictions
+        int high = std::clamp<double>(std::floor(prediction) + model.error + 1, model.firstPosition + 1, segmentEnd);
+        int low = std::clamp<double>(std::ceil(prediction) - model.error, model.firstPosition + 1, high);
+
+        while (low < high)
+        {
+            const int middle = (low + high) / 2;
+            if (keys[middle] < value)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        return low;
+    }
+
+private:
+    struct Segment
+    {
+        T firstKey;
+        double slope;
+        int firstPosition;
+        int error;
+    };
+
+    static double predict(const Segment &model, const T &value)
+    {
+        return model.firstPosition + (static_cast<double>(value) - static_cast<double>(model.firstKey)) * model.slope;
+    }
+
+    vector<Segment> segments;
+    vector<T> firstKeys;
+    int maximumErrorValue{};
+};
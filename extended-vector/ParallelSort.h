@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <cstddef>
+#include <algorithm>
+using std::move;
+using std::size_t;
+using std::vector;
+
+/// Merges two sorted, duplicate free ranges skipping the values already written, so the output is
+/// sorted and duplicate free too. Returns the end of the output.
+template <class T>
+T *mergeUnique(const T *first, const T *firstEnd, const T *second, const T *secondEnd, T *output)
+{
+    T *const outputBegin = output;
+    auto write = [&](const T &value)
+    {
+        if (output == outputBegin || *(output - 1) < value)
+            *output++ = value;
+    };
+
+    while (first != firstEnd && second != secondEnd)
+        write(*second < *first ? *second++ : *first++);
+    while (first != firstEnd)
+        write(*first++);
+    while (second != secondEnd)
+        write(*second++);
+
+    return output;
+}
+
+/// Sorts <<values>> and, when <<unique>> is set, removes the duplicates, on <<threadCount>> threads:
+/// every thread sorts (and deduplicates) one part, then the parts are merged in pairs, the pairs of a
+/// round in parallel, alternating between <<values>> and a buffer of the same size.
+template <class T>
+void parallelSort(vector<T> &values, bool unique, int threadCount = std::thread::hardware_concurrency())
+{
+    threadCount = std::clamp<int>(threadCount, 1, std::max<size_t>(values.size() / 4096, 1));
+    if (threadCount == 1)
+    {
+        std::sort(values.begin(), values.end());
+        if (unique)
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+        return;
+    }
+
+    // Part p is [begins[p], ends[p]) of the current array
+    vector<size_t> begins(threadCount), ends(threadCount);
+    vector<std::thread> threads;
+    for (int part = 0; part < threadCount; part++)
+    {
+        begins[part] = values.size() * part / threadCount;
+        ends[part] = values.size() * (part + 1) / threadCount;
+        threads.emplace_back([&, part]
+                             {
+                                 std::sort(values.begin() + begins[part], values.begin() + ends[part]);
+                                 if (unique)
+                                     ends[part] = std::unique(values.begin() + begins[part], values.begin() + ends[part]) - values.begin(); });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    vector<T> buffer(values.size());
+    T *current = values.data();
+    T *next = buffer.data();
+
+    while (begins.size() > 1)
+    {
+        const size_t partCount = begins.size();
+        vector<size_t> nextBegins, nextEnds;
+        for (size_t part = 0; part < partCount; part += 2)
+        {
+            nextBegins.push_back(begins[part]);
+            nextEnds.push_back(part + 1 < partCount ? begins[part] + ends[part] - begins[part] + ends[part + 1] - begins[part + 1] : ends[part]);
+        }
+
+        threads.clear();
+        for (size_t part = 0; part < partCount; part += 2)
+            threads.emplace_back([&, part]
+                                 {
+                                     T *output = next + begins[part];
+                                     if (part + 1 == partCount)
+                                         std::copy(current + begins[part], current + ends[part], output);
+                                     else if (unique)
+                                         nextEnds[part / 2] = mergeUnique(current + begins[part], current + ends[part], current + begins[part + 1],
+                                                                          current + ends[part + 1], output) - next;
+                                     else
+                                         std::merge(current + begins[part], current + ends[part], current + begins[part + 1],
+                                                    current + ends[part + 1], output); });
+        for (auto &thread : threads)
+            thread.join();
+
+        begins = move(nextBegins);
+        ends = move(nextEnds);
+        std::swap(current, next);
+    }
+
+    const size_t size = ends[0];
+    if (current != values.data())
+        std::copy(current, current + size, values.data());
+    values.resize(size);
+}
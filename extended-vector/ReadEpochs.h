@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <limits>
+using std::exception;
+
+class TooManyReaderThreadsException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "Too many threads read at the same time. The limit is ReadEpochs::MAX_READER_THREADS.";
+    }
+};
+
+/// Epoch-based reclamation for data read without locks. A reader announces the current epoch in a
+/// slot of its own before reading shared pointers and clears it when it is done, which never waits.
+/// A writer that unlinks an object retires it with retireEpoch() and deletes it once that epoch is
+/// older than oldestReader(), i.e. when every reader that could still see it has left.
+namespace ReadEpochs
+{
+    constexpr int MAX_READER_THREADS = 256;
+    constexpr std::uint64_t IDLE = std::numeric_limits<std::uint64_t>::max();
+
+    /// One cache line per slot, so that readers do not invalidate each other's lines
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> epoch{IDLE};
+        std::atomic<bool> taken{false};
+    };
+
+    inline Slot slots[MAX_READER_THREADS];
+    inline std::atomic<std::uint64_t> globalEpoch{1};
+
+    /// Slot of the calling thread, claimed on its first read and released when it ends.
+    struct ThreadSlot
+    {
+        ThreadSlot()
+        {
+            for (index = 0; index < MAX_READER_THREADS; index++)
+            {
+                bool expected = false;
+                if (slots[index].taken.compare_exchange_strong(expected, true))
+                    return;
+            }
+
+            throw TooManyReaderThreadsException();
+        }
+
+        ~ThreadSlot()
+        {
+            slots[index].epoch.store(IDLE);
+            slots[index].taken.store(false);
+        }
+
+        int index;
+        /// Nested read sections only announce an epoch in the outermost one
+        int depth{};
+    };
+
+    inline thread_local ThreadSlot threadSlot;
+
+    /// Starts a read section: the objects reachable now are not deleted before leave().
+    inline void enter()
+    {
+        ThreadSlot &slot = threadSlot;
+        if (slot.depth++ == 0)
+            // Sequentially consistent, so that it is seen by a writer before the shared pointer is read
+            slots[slot.index].epoch.store(globalEpoch.load());
+    }
+
+    inline void leave()
+    {
+        ThreadSlot &slot = threadSlot;
+        if (--slot.depth == 0)
+            slots[slot.index].epoch.store(IDLE, std::memory_order_release);
+    }
+
+    /// Called by a writer after unlinking an object: the epoch at which it is retired.
+    inline std::uint64_t retireEpoch() { return globalEpoch.fetch_add(1); }
+
+    /// Epoch of the oldest reader still in a read section (IDLE if there is none). The objects retired
+    /// at an earlier epoch can be deleted.
+    inline std::uint64_t oldestReader()
+    {
+        std::uint64_t oldest = IDLE;
+        for (const Slot &slot : slots)
+            oldest = std::min(oldest, slot.epoch.load());
+
+        return oldest;
+    }
+}
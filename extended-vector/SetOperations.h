@@ -0,0 +1,383 @@
+#pragma once
+#include "ExtendedVector.h"
+#include "KAryLayout.h"
+#include <span>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+using std::size_t;
+using std::span;
+
+/// Kernels of the set operations over strictly increasing arrays. They write into <<output>>, which
+/// may be <<a>> itself (not <<b>>) except for unite, and return the number of elements written.
+/// The AVX2 intersection compares a block of 8 keys of <<a>> with the 8 rotations of a block of
+/// <<b>>, then packs the matching keys with one shuffle; the block whose last key is smaller moves on.
+namespace SetKernels
+{
+    namespace scalar
+    {
+        template <class T>
+        size_t intersect(const T *a, size_t aSize, const T *b, size_t bSize, T *output)
+        {
+            size_t i = 0, j = 0, written = 0;
+            while (i < aSize && j < bSize)
+            {
+                const T x = a[i], y = b[j];
+                // Branchless: the key is always written, and kept only when it matches
+                output[written] = x;
+                written += x == y;
+                i += x <= y;
+                j += y <= x;
+            }
+
+            return written;
+        }
+
+        template <class T>
+        size_t difference(const T *a, size_t aSize, const T *b, size_t bSize, T *output)
+        {
+            size_t i = 0, j = 0, written = 0;
+            while (i < aSize && j < bSize)
+            {
+                const T x = a[i], y = b[j];
+                output[written] = x;
+                written += x < y;
+                i += x <= y;
+                j += y <= x;
+            }
+
+            // Not std::copy: output may be the same as a
+            while (i < aSize)
+                output[written++] = a[i++];
+            return written;
+        }
+
+        template <class T>
+        size_t unite(const T *a, size_t aSize, const T *b, size_t bSize, T *output)
+        {
+            size_t i = 0, j = 0, written = 0;
+            while (i < aSize && j < bSize)
+            {
+                const T x = a[i], y = b[j];
+                output[written++] = y < x ? y : x;
+                i += x <= y;
+                j += y <= x;
+            }
+
+            written = std::copy(a + i, a + aSize, output + written) - output;
+            return std::copy(b + j, b + bSize, output + written) - output;
+        }
+    }
+
+    /// First position from <<start>> of the sorted <<keys>> not less than <<value>>: an exponential
+    /// search for a range holding it, then a binary search of that range, in O(log distance).
+    template <class T>
+    size_t gallop(const T *keys, size_t size, size_t start, const T &value)
+    {
+        size_t step = 1;
+        while (start + step < size && keys[start + step] < value)
+            step *= 2;
+
+        return std::lower_bound(keys + start + step / 2, keys + std::min(size, start + step + 1), value) - keys;
+    }
+
+    /// Intersection of a <<small>> and a much larger array: one gallop per key of <<small>>.
+    template <class T>
+    size_t gallopingIntersect(const T *small, size_t smallSize, const T *large, size_t largeSize, T *output)
+    {
+        size_t j = 0, written = 0;
+        for (size_t i = 0; i < smallSize && j < largeSize; i++)
+        {
+            const T value = small[i];
+            j = gallop(large, largeSize, j, value);
+            if (j < largeSize && large[j] == value)
+            {
+                output[written++] = value;
+                j++;
+            }
+        }
+
+        return written;
+    }
+
+    /// <<small>> minus a much larger array.
+    template <class T>
+    size_t gallopingDifference(const T *small, size_t smallSize, const T *large, size_t largeSize, T *output)
+    {
+        size_t j = 0, written = 0;
+        for (size_t i = 0; i < smallSize; i++)
+        {
+            const T value = small[i];
+            j = gallop(large, largeSize, j, value);
+            if (j == largeSize || !(large[j] == value))
+                output[written++] = value;
+        }
+
+        return written;
+    }
+
+#ifdef KARY_AVX2_KERNELS
+    /// Whether there is an AVX2 kernel for the keys of type T: 32-bit integers.
+    template <class T>
+    constexpr bool hasAvx2Kernel = std::is_integral_v<T> && sizeof(T) == 4;
+
+    namespace avx2
+    {
+        /// For every mask of 8 lanes, the lanes set, in order, as permutation indices.
+        inline constexpr auto PACK_INDICES = []()
+        {
+            std::array<std::array<std::uint8_t, 8>, 256> indices{};
+            for (int mask = 0; mask < 256; mask++)
+            {
+                int packed = 0;
+                for (int lane = 0; lane < 8; lane++)
+                    if (mask >> lane & 1)
+                        indices[mask][packed++] = lane;
+            }
+            return indices;
+        }();
+
+        /// Lanes of <<keys>> whose bit is set in <<mask>>, written at <<output>> without going past them.
+        template <class T>
+        __attribute__((target("avx2,popcnt"))) size_t pack(__m256i keys, int mask, T *output)
+        {
+            const __m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(PACK_INDICES[mask].data())));
+            const int count = __builtin_popcount(mask);
+            const __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            _mm256_maskstore_epi32(reinterpret_cast<int *>(output), lanes, _mm256_permutevar8x32_epi32(keys, permutation));
+            return count;
+        }
+
+        /// Lanes of the 8 keys at <<a>> equal to one of the 8 keys at <<b>>.
+        __attribute__((target("avx2"))) inline int matches(const void *a, const void *b)
+        {
+            const __m256i x = _mm256_loadu_si256(static_cast<const __m256i *>(a));
+            __m256i y = _mm256_loadu_si256(static_cast<const __m256i *>(b));
+            const __m256i rotation = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+            __m256i equal = _mm256_cmpeq_epi32(x, y);
+            for (int step = 1; step < 8; step++)
+            {
+                y = _mm256_permutevar8x32_epi32(y, rotation);
+                equal = _mm256_or_si256(equal, _mm256_cmpeq_epi32(x, y));
+            }
+
+            return _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+        }
+
+        /// Keys of <<a>> found in <<b>> (KEEP_MATCHES) or not found in it. A block of a is written once
+        /// it moves on, with the matches of all the blocks of b it was compared with, so that the output
+        /// can be a: the block has been read by then.
+        template <bool KEEP_MATCHES, class T>
+        __attribute__((target("avx2,popcnt"))) size_t filter(const T *a, size_t aSize, const T *b, size_t bSize, T *output)
+        {
+            size_t i = 0, j = 0, written = 0;
+            // Keys of the current block of a found in the blocks of b seen so far
+            int matched = 0;
+            while (i + 8 <= aSize && j + 8 <= bSize)
+            {
+                matched |= matches(a + i, b + j);
+
+                const T aLast = a[i + 7], bLast = b[j + 7];
+                if (aLast <= bLast)
+                {
+                    const __m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                    written += pack(keys, KEEP_MATCHES ? matched : ~matched & 0xFF, output + written);
+                    matched = 0;
+                    i += 8;
+                }
+                j += bLast <= aLast ? 8 : 0;
+            }
+
+            // The current block of a may already have matches: finish it against the rest of b
+            if (i + 8 <= aSize)
+            {
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    const bool found = matched >> lane & 1 || std::binary_search(b + j, b + bSize, a[i + lane]);
+                    if (found == KEEP_MATCHES)
+                        output[written++] = a[i + lane];
+                }
+                i += 8;
+            }
+
+            if constexpr (KEEP_MATCHES)
+                return written + scalar::intersect(a + i, aSize - i, b + j, bSize - j, output + written);
+            else
+                return written + scalar::difference(a + i, aSize - i, b + j, bSize - j, output + written);
+        }
+
+        template <class T>
+        size_t intersect(const T *a, size_t aSize, const T *b, size_t bSize, T *output)
+        {
+            return filter<true>(a, aSize, b, bSize, output);
+        }
+
+        template <class T>
+        size_t difference(const T *a, size_t aSize, const T *b, size_t bSize, T *output)
+        {
+            return filter<false>(a, aSize, b, bSize, output);
+        }
+    }
+#endif
+}
+
+/// When one array is this many times larger than the other, intersections and differences gallop.
+constexpr size_t GALLOPING_RATIO = 32;
+
+/// Keys of both strictly increasing arrays, in order. <<output>> needs min(a.size(), b.size())
+/// elements and may be <<a>>. Returns the number of keys written.
+template <class T>
+size_t sortedIntersection(span<const T> a, span<const T> b, span<T> output)
+{
+    if (a.size() * GALLOPING_RATIO < b.size())
+        return SetKernels::gallopingIntersect(a.data(), a.size(), b.data(), b.size(), output.data());
+    if (b.size() * GALLOPING_RATIO < a.size())
+        return SetKernels::gallopingIntersect(b.data(), b.size(), a.data(), a.size(), output.data());
+
+#ifdef KARY_AVX2_KERNELS
+    if constexpr (SetKernels::hasAvx2Kernel<T>)
+        if (KAryKernels::avx2Supported())
+            return SetKernels::avx2::intersect(a.data(), a.size(), b.data(), b.size(), output.data());
+#endif
+
+    return SetKernels::scalar::intersect(a.data(), a.size(), b.data(), b.size(), output.data());
+}
+
+/// Intersection by galloping through the larger array, whatever the sizes.
+template <class T>
+size_t gallopingIntersection(span<const T> a, span<const T> b, span<T> output)
+{
+    if (b.size() < a.size())
+        return SetKernels::gallopingIntersect(b.data(), b.size(), a.data(), a.size(), output.data());
+
+    return SetKernels::gallopingIntersect(a.data(), a.size(), b.data(), b.size(), output.data());
+}
+
+/// Keys of <<a>> not in <<b>>. <<output>> needs a.size() elements and may be <<a>>.
+template <class T>
+size_t sortedDifference(span<const T> a, span<const T> b, span<T> output)
+{
+    if (a.size() * GALLOPING_RATIO < b.size())
+        return SetKernels::gallopingDifference(a.data(), a.size(), b.data(), b.size(), output.data());
+
+#ifdef KARY_AVX2_KERNELS
+    if constexpr (SetKernels::hasAvx2Kernel<T>)
+        if (KAryKernels::avx2Supported())
+            return SetKernels::avx2::difference(a.data(), a.size(), b.data(), b.size(), output.data());
+#endif
+
+    return SetKernels::scalar::difference(a.data(), a.size(), b.data(), b.size(), output.data());
+}
+
+/// Keys of either array, once. <<output>> needs a.size() + b.size() elements and must not overlap them.
+template <class T>
+size_t sortedUnion(span<const T> a, span<const T> b, span<T> output)
+{
+    return SetKernels::scalar::unite(a.data(), a.size(), b.data(), b.size(), output.data());
+}
+
+/// The set operations over sorted ExtendedVectors without duplicates, e.g. posting lists. The
+/// insertion buffers are merged first.
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t sortedIntersection(const ExtendedVector<T, Storage> &a, const ExtendedVector<T, Storage> &b, span<T> output)
+{
+    return sortedIntersection(a.storage().view(), b.storage().view(), output);
+}
+
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t gallopingIntersection(const ExtendedVector<T, Storage> &a, const ExtendedVector<T, Storage> &b, span<T> output)
+{
+    return gallopingIntersection(a.storage().view(), b.storage().view(), output);
+}
+
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t sortedDifference(const ExtendedVector<T, Storage> &a, const ExtendedVector<T, Storage> &b, span<T> output)
+{
+    return sortedDifference(a.storage().view(), b.storage().view(), output);
+}
+
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t sortedUnion(const ExtendedVector<T, Storage> &a, const ExtendedVector<T, Storage> &b, span<T> output)
+{
+    return sortedUnion(a.storage().view(), b.storage().view(), output);
+}
+
+/// Keys of all the <<lists>>. <<output>> needs as many elements as the smallest list. The smallest
+/// list is intersected first, then the result with the others, in place.
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t sortedIntersection(std::initializer_list<const ExtendedVector<T, Storage> *> lists, span<T> output)
+{
+    if (lists.size() == 0)
+        return 0;
+
+    auto smallest = std::min_element(lists.begin(), lists.end(), [](auto *left, auto *right)
+                                     { return left->count() < right->count(); });
+    span<const T> first = (*smallest)->storage().view();
+    if (lists.size() == 1)
+        return std::copy(first.begin(), first.end(), output.begin()) - output.begin();
+
+    size_t size = 0;
+    bool started = false;
+    for (auto list = lists.begin(); list != lists.end(); list++)
+    {
+        if (list == smallest)
+            continue;
+
+        span<const T> current = started ? span<const T>(output.data(), size) : first;
+        size = sortedIntersection(current, (*list)->storage().view(), output);
+        started = true;
+    }
+
+    return size;
+}
+
+/// Keys of the first list in none of the others. <<output>> needs as many elements as the first list.
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t sortedDifference(std::initializer_list<const ExtendedVector<T, Storage> *> lists, span<T> output)
+{
+    if (lists.size() == 0)
+        return 0;
+
+    span<const T> first = (*lists.begin())->storage().view();
+    size_t size = std::copy(first.begin(), first.end(), output.begin()) - output.begin();
+    for (auto list = lists.begin() + 1; list != lists.end(); list++)
+        size = sortedDifference(span<const T>(output.data(), size), (*list)->storage().view(), output);
+
+    return size;
+}
+
+/// Keys of any of the lists, once. <<output>> and <<scratch>> both need the total size of the lists;
+/// the partial unions alternate between them.
+template <class T, class Storage>
+    requires Storage::CONTIGUOUS
+size_t sortedUnion(std::initializer_list<const ExtendedVector<T, Storage> *> lists, span<T> output, span<T> scratch)
+{
+    // Start in the buffer that makes the last union land in output
+    span<T> current = lists.size() % 2 == 0 ? scratch : output;
+    span<T> next = lists.size() % 2 == 0 ? output : scratch;
+    size_t size = 0;
+    for (auto *list : lists)
+    {
+        span<const T> keys = list->storage().view();
+        if (size == 0)
+        {
+            size = std::copy(keys.begin(), keys.end(), current.begin()) - current.begin();
+            std::swap(current, next);
+            continue;
+        }
+
+        size = sortedUnion(span<const T>(next.data(), size), keys, current);
+        std::swap(current, next);
+    }
+
+    return size;
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include "EytzingerLayout.h"
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+using std::move;
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// ExtendedVector storage keeping up to <<INLINE_CAPACITY>> elements inside the object itself, so
+/// small containers never allocate. Larger ones move to a buffer obtained from <<Allocator>>, which
+/// grows geometrically as a vector does. Like VectorStorage, the elements are contiguous.
+template <class T, size_t INLINE_CAPACITY = 16, class Allocator = std::allocator<T>>
+class SmallVectorStorage
+{
+
+public:
+    static_assert(INLINE_CAPACITY > 0);
+    static constexpr bool CONTIGUOUS = true;
+    using allocator_type = Allocator;
+    using const_iterator = const T *;
+
+    SmallVectorStorage() = default;
+    explicit SmallVectorStorage(const Allocator &allocatorParam) : allocator(allocatorParam) {}
+
+    SmallVectorStorage(const SmallVectorStorage &other)
+        : allocator(Traits::select_on_container_copy_construction(other.allocator))
+    {
+        append(other.view());
+    }
+
+    SmallVectorStorage(SmallVectorStorage &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+        : allocator(other.allocator)
+    {
+        take(other);
+    }
+
+    SmallVectorStorage &operator=(const SmallVectorStorage &other)
+    {
+        if (this != &other)
+        {
+            clear();
+            append(other.view());
+        }
+        return *this;
+    }
+
+    SmallVectorStorage &operator=(SmallVectorStorage &&other)
+    {
+        if (this == &other)
+            return *this;
+
+        clear();
+        if (!other.isInline() && allocator != other.allocator)
+        {
+            // The buffer cannot be released by this allocator: copy the elements instead
+            append(other.view());
+            other.clear();
+            return *this;
+        }
+
+        releaseBuffer();
+        take(other);
+        return *this;
+    }
+
+    ~SmallVectorStorage()
+    {
+        clear();
+        releaseBuffer();
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return capacityValue; }
+    /// Whether the elements are still in the inline buffer.
+    bool isInline() const { return elements == inlineElements(); }
+
+    const T &operator[](size_t position) const { return elements[position]; }
+    const_iterator begin() const { return elements; }
+    const_iterator end() const { return elements + count; }
+    span<const T> view() const { return span<const T>(elements, count); }
+
+    void reserve(size_t newCapacity)
+    {
+        if (newCapacity <= capacityValue)
+            return;
+
+        T *buffer = Traits::allocate(allocator, newCapacity);
+        std::uninitialized_move(elements, elements + count, buffer);
+        std::destroy(elements, elements + count);
+        releaseBuffer();
+        elements = buffer;
+        capacityValue = newCapacity;
+    }
+
+    void push_back(const T &value)
+    {
+        if (count == capacityValue)
+        {
+            // The value may be an element of this storage: copy it before growing
+            T copy(value);
+            reserve(capacityValue * 2);
+            ::new (static_cast<void *>(elements + count)) T(move(copy));
+        }
+        else
+            ::new (static_cast<void *>(elements + count)) T(value);
+
+        count++;
+    }
+
+    void assign(vector<T> &&items)
+    {
+        clear();
+        append(span<const T>(items));
+    }
+
+    void append(span<const T> items)
+    {
+        if (count + items.size() > capacityValue)
+            reserve(std::max(count + items.size(), capacityValue * 2));
+        std::uninitialized_copy(items.begin(), items.end(), elements + count);
+        count += items.size();
+    }
+
+    void eraseAt(size_t position)
+    {
+        std::move(elements + position + 1, elements + count, elements + position);
+        std::destroy_at(elements + --count);
+    }
+
+    void clear()
+    {
+        std::destroy(elements, elements + count);
+        count = 0;
+    }
+
+    void sort() { std::sort(elements, elements + count); }
+
+    /// Position of the first element not less than <<value>>. The elements must be sorted.
+    size_t lowerBound(const T &value) const { return branchlessLowerBound(view(), value); }
+
+    /// Merges sorted values into the sorted elements from the back, as VectorStorage::mergeSorted.
+    void mergeSorted(span<const T> sorted)
+    {
+        const size_t oldSize = count;
+        append(sorted);
+
+        T *output = elements + count;
+        T *left = elements + oldSize;
+        const T *right = sorted.data() + sorted.size();
+        while (right != sorted.data() && left != elements)
+            *--output = *(right - 1) < *(left - 1) ? move(*--left) : *--right;
+        while (right != sorted.data())
+            *--output = *--right;
+    }
+
+private:
+    using Traits = std::allocator_traits<Allocator>;
+
+    T *inlineElements() { return reinterpret_cast<T *>(inlineBuffer); }
+    const T *inlineElements() const { return reinterpret_cast<const T *>(inlineBuffer); }
+
+    void releaseBuffer()
+    {
+        if (!isInline())
+            Traits::deallocate(allocator, elements, capacityValue);
+
+        elements = inlineElements();
+        capacityValue = INLINE_CAPACITY;
+    }
+
+    /// Moves the elements of <<other>>, which must be empty or share the allocator, leaving it empty.
+    void take(SmallVectorStorage &other)
+    {
+        if (other.isInline())
+        {
+            std::uninitialized_move(other.elements, other.elements + other.count, elements);
+            count = other.count;
+            other.clear();
+            return;
+        }
+
+        elements = other.elements;
+        count = other.count;
+        capacityValue = other.capacityValue;
+        other.elements = other.inlineElements();
+        other.count = 0;
+        other.capacityValue = INLINE_CAPACITY;
+    }
+
+    alignas(T) std::byte inlineBuffer[INLINE_CAPACITY * sizeof(T)];
+    T *elements{inlineElements()};
+    size_t count{};
+    size_t capacityValue{INLINE_CAPACITY};
+    [[no_unique_address]] Allocator allocator;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include "EytzingerLayout.h"
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+using std::move;
+using std::size_t;
+using std::span;
+using std::vector;
+
+/// Default ExtendedVector storage: the elements in one vector. Positional access is O(1), but
+/// inserting or erasing in the middle moves the whole tail. <<Allocator>> can be a
+/// std::pmr::polymorphic_allocator, e.g. over a monotonic_buffer_resource arena.
+template <class T, class Allocator = std::allocator<T>>
+class VectorStorage
+{
+
+public:
+    /// Whether view() gives all the elements as one span.
+    static constexpr bool CONTIGUOUS = true;
+    using allocator_type = Allocator;
+    using const_iterator = typename vector<T, Allocator>::const_iterator;
+
+    VectorStorage() = default;
+    explicit VectorStorage(const Allocator &allocator) : values(allocator) {}
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    const T &operator[](size_t position) const { return values[position]; }
+    const_iterator begin() const { return values.begin(); }
+    const_iterator end() const { return values.end(); }
+    span<const T> view() const { return span<const T>(values); }
+
+    /// Replaces the elements, taking the vector over when it uses the same allocator type.
+    void assign(vector<T> &&items)
+    {
+        if constexpr (std::is_same_v<Allocator, std::allocator<T>>)
+            values = move(items);
+        else
+            values.assign(items.begin(), items.end());
+    }
+
+    void reserve(size_t capacity) { values.reserve(capacity); }
+    void push_back(const T &value) { values.push_back(value); }
+    void append(span<const T> items) { values.insert(values.end(), items.begin(), items.end()); }
+    void eraseAt(size_t position) { values.erase(values.begin() + position); }
+    void sort() { std::sort(values.begin(), values.end()); }
+
+    /// Position of the first element not less than <<value>>. The elements must be sorted.
+    size_t lowerBound(const T &value) const { return branchlessLowerBound(view(), value); }
+
+    /// Merges sorted values into the sorted elements from the back, so that nothing is moved twice
+    /// and the only allocation is the growth of the vector. New elements go after equal old ones.
+    void mergeSorted(span<const T> sorted)
+    {
+        const size_t oldSize = values.size();
+        values.insert(values.end(), sorted.begin(), sorted.end());
+
+        auto output = values.end();
+        auto left = values.begin() + oldSize;
+        auto right = sorted.end();
+        while (right != sorted.begin() && left != values.begin())
+            *--output = *(right - 1) < *(left - 1) ? move(*--left) : *--right;
+        while (right != sorted.begin())
+            *--output = *--right;
+    }
+
+private:
+    vector<T, Allocator> values;
+};
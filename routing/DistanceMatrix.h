@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+using std::size_t;
+using std::vector;
+
+/// Dense and symmetric distance matrix stored row by row in a single buffer.
+class DistanceMatrix
+{
+
+public:
+    DistanceMatrix() = delete;
+    DistanceMatrix(const vector<vector<double>> &matrix) : dimension(matrix.size())
+    {
+        distances.reserve(static_cast<size_t>(dimension) * dimension);
+        for (auto &row : matrix)
+            distances.insert(distances.end(), row.begin(), row.begin() + dimension);
+    }
+
+    template <class Callback>
+    DistanceMatrix(int dimensionParam, Callback distance) : dimension(dimensionParam)
+    {
+        distances.resize(static_cast<size_t>(dimension) * dimension);
+        for (int from = 0; from < dimension; from++)
+            for (int to = 0; to < dimension; to++)
+                distances[static_cast<size_t>(from) * dimension + to] = distance(from, to);
+    }
+
+    double operator()(int from, int to) const
+    {
+        return distances[static_cast<size_t>(from) * dimension + to];
+    }
+
+    int size() const { return dimension; }
+    const double *data() const { return distances.data(); }
+
+private:
+    int dimension;
+    vector<double> distances;
+};
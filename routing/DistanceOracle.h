@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+using std::size_t;
+using std::unique_ptr;
+using std::vector;
+
+struct Point
+{
+    double x;
+    double y;
+};
+
+/// Euclidean distances between points computed on demand, for instances too large for a DistanceMatrix.
+/// The (symmetric) matrix is split in square tiles of TILE_SIZE x TILE_SIZE distances; a tile is
+/// computed the first time one of its distances is asked for and kept in a 4-way set associative cache
+/// (least recently used tile evicted) that never grows beyond the given memory budget. Tiles start on
+/// cache line boundaries. The cache pays off when consecutive queries involve nearby ids, so the ids
+/// should follow a spatial order (e.g. the points sorted along a space filling curve or a route).
+/// The oracle is not thread safe: give each thread its own one.
+class TiledDistanceOracle
+{
+
+public:
+    static constexpr int TILE_SIZE = 32;
+    static constexpr int WAYS = 4;
+    static constexpr size_t TILE_BYTES = TILE_SIZE * TILE_SIZE * sizeof(double);
+    static constexpr size_t CACHE_LINE = 64;
+
+    TiledDistanceOracle() = delete;
+    TiledDistanceOracle(const vector<Point> &pointsParam, size_t memoryBudget) : points(pointsParam)
+    {
+        tilesPerRow = (points.size() + TILE_SIZE - 1) / TILE_SIZE;
+        setCount = std::max<size_t>(memoryBudget / TILE_BYTES / WAYS, 1);
+
+        tiles.reset(static_cast<double *>(::operator new(setCount * WAYS * TILE_BYTES, std::align_val_t(CACHE_LINE))));
+        tags.assign(setCount * WAYS, EMPTY);
+        lastUse.assign(setCount * WAYS, 0);
+    }
+
+    TiledDistanceOracle(const TiledDistanceOracle &other) : TiledDistanceOracle(other.points, other.memoryFootprint()) {}
+
+    double operator()(int from, int to) const
+    {
+        if (from > to)
+            std::swap(from, to);
+
+        const size_t key = static_cast<size_t>(from / TILE_SIZE) * tilesPerRow + to / TILE_SIZE;
+        const double *tile = findTile(key);
+        return tile[(from % TILE_SIZE) * TILE_SIZE + to % TILE_SIZE];
+    }
+
+    int size() const { return points.size(); }
+    const vector<Point> &getPoints() const { return points; }
+
+    long long hits() const { return hitCount; }
+    long long misses() const { return missCount; }
+    void resetCounters() { hitCount = missCount = 0; }
+
+    /// Bytes used by the cached tiles, at most the memory budget (but at least one set of tiles).
+    size_t memoryFootprint() const { return setCount * WAYS * TILE_BYTES; }
+
+private:
+    static constexpr size_t EMPTY = SIZE_MAX;
+
+    struct AlignedDelete
+    {
+        void operator()(double *data) const { ::operator delete(data, std::align_val_t(CACHE_LINE)); }
+    };
+
+    const double *findTile(size_t key) const
+    {
+        const size_t set = (key * 0x9e3779b97f4a7c15ULL >> 17) % setCount;
+        const size_t firstWay = set * WAYS;
+        clock++;
+
+        size_t victim = firstWay;
+        for (size_t way = firstWay; way < firstWay + WAYS; way++)
+        {
+            if (tags[way] == key)
+            {
+                hitCount++;
+                lastUse[way] = clock;
+                return tiles.get() + way * TILE_SIZE * TILE_SIZE;
+            }
+
+            if (lastUse[way] < lastUse[victim])
+                victim = way;
+        }
+
+        missCount++;
+        tags[victim] = key;
+        lastUse[victim] = clock;
+        double *tile = tiles.get() + victim * TILE_SIZE * TILE_SIZE;
+        fillTile(tile, key / tilesPerRow * TILE_SIZE, key % tilesPerRow * TILE_SIZE);
+        return tile;
+    }
+
+    void fillTile(double *tile, int firstRow, int firstColumn) const
+    {
+        const int rows = std::min<int>(TILE_SIZE, points.size() - firstRow);
+        const int columns = std::min<int>(TILE_SIZE, points.size() - firstColumn);
+
+        for (int row = 0; row < rows; row++)
+        {
+            const Point &from = points[firstRow + row];
+            for (int column = 0; column < columns; column++)
+            {
+                const Point &to = points[firstColumn + column];
+                tile[row * TILE_SIZE + column] = std::sqrt((from.x - to.x) * (from.x - to.x) + (from.y - to.y) * (from.y - to.y));
+            }
+        }
+    }
+
+    vector<Point> points;
+    size_t tilesPerRow;
+    size_t setCount;
+    unique_ptr<double[], AlignedDelete> tiles;
+    mutable vector<size_t> tags;
+    mutable vector<unsigned long long> lastUse;
+    mutable unsigned long long clock{};
+    mutable long long hitCount{};
+    mutable long long missCount{};
+};
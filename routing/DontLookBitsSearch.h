@@ -0,0 +1,240 @@
+#pragma once
+#include "TwoOpt.h"
+#include "ThreeOpt.h"
+#include <vector>
+#include <deque>
+#include <utility>
+#include <algorithm>
+using std::deque;
+using std::vector;
+
+/// Local search over two-opt, or-opt (segments of one to three elements, relocated as they are or
+/// reversed) and three-opt moves (two consecutive segments reconnected in the four ways of
+/// ThreeOptReconnection, the first one at most THREE_OPT_SEGMENT_LENGTH long) driven by don't-look
+/// bits. Each route element has a bit telling that no improving move starting from it was found; the
+/// search only looks at elements whose bit is off, and the bits of the endpoints of every changed edge
+/// are turned off again, so after the first pass only the neighbourhoods that changed are evaluated.
+/// Route elements must be ids in [0, n) that <<Distance>> accepts.
+template <class Distance>
+class DontLookBitsSearch
+{
+
+public:
+    static constexpr double MINIMUM_GAIN = MINIMUM_TWO_OPT_GAIN;
+    /// Longest first segment of the three-opt moves, which keeps a look at an element linear in the route size
+    static constexpr int THREE_OPT_SEGMENT_LENGTH = 8;
+
+    /// Without don't-look bits every element is looked at again after each applied move, which is what
+    /// re-running the whole search does. It is only kept to measure what the bits save.
+    DontLookBitsSearch(Distance distanceParam, bool useDontLookBitsParam = true)
+        : distance(std::move(distanceParam)), useDontLookBits(useDontLookBitsParam) {}
+
+    /// Improves the route until every element has its don't-look bit on. Returns the number of applied moves.
+    long long optimize(vector<int> &route)
+    {
+        return optimize(route, route, false);
+    }
+
+    /// Improves a route that was already optimized and then changed by the caller (e.g. perturbed by a
+    /// random move), only turning off the bits of <<changedElements>>: the endpoints of the edges that
+    /// changed. It is much cheaper than optimizing the route again from scratch.
+    long long optimize(vector<int> &route, const vector<int> &changedElements)
+    {
+        return optimize(route, changedElements, true);
+    }
+
+    long long evaluatedMoves() const { return evaluated; }
+    long long appliedMoves() const { return applied; }
+
+private:
+    long long optimize(vector<int> &route, const vector<int> &lookedElements, bool othersDontLook)
+    {
+        const long long initiallyApplied = applied;
+        const int size = route.size();
+        if (size < 4)
+            return 0;
+
+        const int maximumElement = *std::max_element(begin(route), end(route));
+        position.assign(maximumElement + 1, -1);
+        dontLook.assign(maximumElement + 1, othersDontLook);
+        for (int i = 0; i < size; i++)
+            position[route[i]] = i;
+
+        queue.clear();
+        for (int element : lookedElements)
+        {
+            dontLook[element] = true;
+            wakeUp(element);
+        }
+
+        while (!queue.empty())
+        {
+            const int element = queue.front();
+            queue.pop_front();
+            dontLook[element] = true;
+
+            if (improveTwoOpt(route, position[element]) || improveOrOpt(route, position[element]) || improveThreeOpt(route, position[element]))
+            {
+                applied++;
+                wakeUp(element);
+                if (!useDontLookBits)
+                    for (int other : route)
+                        wakeUp(other);
+            }
+        }
+
+        return applied - initiallyApplied;
+    }
+
+    void wakeUp(int element)
+    {
+        if (!dontLook[element])
+            return;
+
+        dontLook[element] = false;
+        queue.push_back(element);
+    }
+
+    void updatePositions(const vector<int> &route, int from, int to)
+    {
+        for (int i = from; i <= to; i++)
+            position[route[i]] = i;
+    }
+
+    bool tryTwoOpt(vector<int> &route, int firstIndex, int secondIndex)
+    {
+        const int before = route[firstIndex];
+        const int first = route[firstIndex + 1];
+        const int last = route[secondIndex - 1];
+        const int after = route[secondIndex];
+
+        evaluated++;
+        if (distance(before, first) + distance(last, after) - distance(before, last) - distance(first, after) <= MINIMUM_GAIN)
+            return false;
+
+        twoOptUnchecked(route, firstIndex, secondIndex);
+        updatePositions(route, firstIndex + 1, secondIndex - 1);
+        for (int element : {before, first, last, after})
+            wakeUp(element);
+
+        return true;
+    }
+
+    /// First improving two-opt move removing one of the edges of the element at <<index>>.
+    bool improveTwoOpt(vector<int> &route, int index)
+    {
+        const int size = route.size();
+
+        for (int firstIndex : {index, index - 1})
+            if (firstIndex >= 0)
+                for (int secondIndex = firstIndex + 3; secondIndex < size; secondIndex++)
+                    if (tryTwoOpt(route, firstIndex, secondIndex))
+                        return true;
+
+        for (int secondIndex : {index, index + 1})
+            if (secondIndex < size)
+                for (int firstIndex = 0; firstIndex + 3 <= secondIndex; firstIndex++)
+                    if (tryTwoOpt(route, firstIndex, secondIndex))
+                        return true;
+
+        return false;
+    }
+
+    /// First improving relocation of a segment starting at <<index>>.
+    bool improveOrOpt(vector<int> &route, int index)
+    {
+        const int size = route.size();
+
+        for (int length = 1; length <= 3 && index >= 1 && index + length < size; length++)
+        {
+            const int segmentEnd = index + length - 1;
+            const int previous = route[index - 1];
+            const int first = route[index];
+            const int last = route[segmentEnd];
+            const int next = route[segmentEnd + 1];
+            const double removedGain = distance(previous, first) + distance(last, next) - distance(previous, next);
+
+            for (int insertionIndex = 0; insertionIndex + 1 < size; insertionIndex++)
+            {
+                if (insertionIndex >= index - 1 && insertionIndex <= segmentEnd)
+                    continue;
+
+                const int left = route[insertionIndex];
+                const int right = route[insertionIndex + 1];
+                const double baseGain = removedGain + distance(left, right);
+
+                for (bool reversed : {false, true})
+                {
+                    evaluated++;
+                    const double gain = reversed ? baseGain - distance(left, last) - distance(first, right)
+                                                 : baseGain - distance(left, first) - distance(last, right);
+                    if (gain <= MINIMUM_GAIN)
+                        continue;
+
+                    orOpt(route, index, length, insertionIndex, reversed);
+                    updatePositions(route, std::min(index, insertionIndex + 1), std::max(segmentEnd, insertionIndex));
+                    for (int element : {previous, first, last, next, left, right})
+                        wakeUp(element);
+
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /// First improving three-opt move removing the edge after the element at <<index>>: the segments
+    /// ]index, secondIndex] and ]secondIndex, thirdIndex[ are swapped, reversed or both.
+    bool improveThreeOpt(vector<int> &route, int index)
+    {
+        const int size = route.size();
+        const int firstIndex = index;
+
+        for (int secondIndex = firstIndex + 1; secondIndex <= firstIndex + THREE_OPT_SEGMENT_LENGTH && secondIndex + 2 < size; secondIndex++)
+        {
+            const int a = route[firstIndex];
+            const int b = route[firstIndex + 1];
+            const int c = route[secondIndex];
+            const int d = route[secondIndex + 1];
+            const double firstRemovedGain = distance(a, b) + distance(c, d);
+
+            for (int thirdIndex = secondIndex + 2; thirdIndex < size; thirdIndex++)
+            {
+                const int e = route[thirdIndex - 1];
+                const int f = route[thirdIndex];
+                const double removedGain = firstRemovedGain + distance(e, f);
+
+                // Same order as ThreeOptReconnection
+                const double gains[] = {removedGain - distance(a, d) - distance(e, b) - distance(c, f),
+                                        removedGain - distance(a, d) - distance(e, c) - distance(b, f),
+                                        removedGain - distance(a, e) - distance(d, b) - distance(c, f),
+                                        removedGain - distance(a, c) - distance(b, e) - distance(d, f)};
+
+                for (int reconnection = SWAP_SEGMENTS; reconnection <= REVERSE_BOTH; reconnection++)
+                {
+                    evaluated++;
+                    if (gains[reconnection] <= MINIMUM_GAIN)
+                        continue;
+
+                    threeOpt(route, firstIndex, secondIndex, thirdIndex, static_cast<ThreeOptReconnection>(reconnection));
+                    updatePositions(route, firstIndex + 1, thirdIndex - 1);
+                    for (int element : {a, b, c, d, e, f})
+                        wakeUp(element);
+
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    Distance distance;
+    bool useDontLookBits;
+    vector<int> position;
+    vector<bool> dontLook;
+    deque<int> queue;
+    long long evaluated{};
+    long long applied{};
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include "TwoOptSearch.h"
+#include "WorkStealingPool.h"
+#include <vector>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <memory>
+#include <algorithm>
+using std::unique_ptr;
+using std::vector;
+
+/// Runs TwoOptSearch on many routes, and on several random restarts of each route, spread over a
+/// WorkStealingPool. Restart 0 improves the route as given; the others shuffle the route elements
+/// between its (fixed) first and last ones. Every (route, restart) pair has its own seed, and ties are
+/// broken by the restart number, so the result only depends on the seed and not on the scheduling.
+/// <<Distance>> must be safe to call concurrently; it is shared by reference by all the workers, and
+/// must outlive the MultiStartTwoOpt (a temporary is rejected).
+template <class Distance>
+class MultiStartTwoOpt
+{
+
+public:
+    MultiStartTwoOpt(const Distance &distanceParam, int restartsParam, unsigned long long seedParam,
+                     ImprovementMode modeParam = FIRST_IMPROVEMENT, int threadCount = std::thread::hardware_concurrency())
+        : distance(distanceParam), restarts(std::max(restartsParam, 1)), seed(seedParam), mode(modeParam), pool(threadCount)
+    {
+        for (int worker = 0; worker < pool.size(); worker++)
+            scratch.push_back(std::make_unique<WorkerScratch>(distance, mode));
+    }
+
+    MultiStartTwoOpt(Distance &&, int, unsigned long long, ImprovementMode = FIRST_IMPROVEMENT,
+                     int = std::thread::hardware_concurrency()) = delete;
+
+    /// Best tour found for each route.
+    vector<vector<int>> optimize(const vector<vector<int>> &routes)
+    {
+        vector<RouteResult> results(routes.size());
+
+        pool.run(routes.size() * restarts, [&](size_t task, int worker)
+                 {
+                     const size_t routeIndex = task / restarts;
+                     const int restart = task % restarts;
+                     WorkerScratch &own = *scratch[worker];
+
+                     own.route.assign(routes[routeIndex].begin(), routes[routeIndex].end());
+                     if (restart > 0 && own.route.size() > 3)
+                     {
+                         std::mt19937_64 generator(mix(seed, routeIndex, restart));
+                         std::shuffle(own.route.begin() + 1, own.route.end() - 1, generator);
+                     }
+
+                     own.search.optimize(own.route);
+                     results[routeIndex].offer(own.route, own.search.length(own.route), restart); });
+
+        vector<vector<int>> best;
+        best.reserve(routes.size());
+        for (auto &result : results)
+            best.push_back(std::move(result.route));
+
+        return best;
+    }
+
+    vector<int> optimize(const vector<int> &route)
+    {
+        return optimize(vector<vector<int>>{route}).front();
+    }
+
+    int threadCount() const { return pool.size(); }
+
+private:
+    struct WorkerScratch
+    {
+        WorkerScratch(const Distance &distance, ImprovementMode mode) : search(distance, mode) {}
+
+        TwoOptSearch<const Distance &> search;
+        vector<int> route;
+    };
+
+    struct RouteResult
+    {
+        std::mutex mutex;
+        vector<int> route;
+        double length{};
+        int restart{-1};
+
+        void offer(const vector<int> &candidate, double candidateLength, int candidateRestart)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (restart >= 0 && (length < candidateLength || (length == candidateLength && restart < candidateRestart)))
+                return;
+
+            route.assign(candidate.begin(), candidate.end());
+            length = candidateLength;
+            restart = candidateRestart;
+        }
+    };
+
+    /// SplitMix64 finalizer over the three values, so neighbouring tasks get unrelated seeds.
+    static unsigned long long mix(unsigned long long value, unsigned long long routeIndex, unsigned long long restart)
+    {
+        value += 0x9e3779b97f4a7c15ULL * (routeIndex * 0x100000001b3ULL + restart + 1);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    const Distance &distance;
+    int restarts;
+    unsigned long long seed;
+    ImprovementMode mode;
+    WorkStealingPool pool;
+    vector<unique_ptr<WorkerScratch>> scratch;
+};
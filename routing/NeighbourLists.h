@@ -0,0 +1,196 @@
+#pragma once
+#include "DistanceOracle.h"
+#include <vector>
+#include <span>
+#include <thread>
+#include <future>
+#include <cstddef>
+#include <algorithm>
+#include <exception>
+using std::exception;
+using std::size_t;
+using std::span;
+using std::vector;
+
+class InvalidNeighbourCountException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The number of neighbours per element cannot be negative.";
+    }
+};
+
+/// Static 2-d tree over a set of points, stored flat: the points are reordered so that every subtree
+/// is a contiguous range whose middle element is the subtree root, so there are no node pointers.
+class KdTree
+{
+
+public:
+    KdTree() = delete;
+    KdTree(const vector<Point> &points, int threadCount = std::thread::hardware_concurrency())
+        : ids(points.size()), treePoints(points.size()), axes(points.size())
+    {
+        for (int id = 0; id < static_cast<int>(ids.size()); id++)
+            ids[id] = id;
+
+        int parallelDepth = 0;
+        while ((1 << parallelDepth) < threadCount)
+            parallelDepth++;
+
+        build(points, 0, ids.size(), parallelDepth);
+        for (int node = 0; node < static_cast<int>(ids.size()); node++)
+            treePoints[node] = points[ids[node]];
+    }
+
+    /// Ids of the <<count>> points closest to <<query>> (excluding <<excludedId>>), closest first.
+    void nearest(const Point &query, int count, int excludedId, vector<int> &result) const
+    {
+        result.clear();
+        if (count <= 0)
+            return;
+
+        thread_local vector<Candidate> heap;
+        heap.clear();
+        search(query, count, excludedId, 0, ids.size(), heap);
+
+        std::sort_heap(heap.begin(), heap.end());
+        for (auto &candidate : heap)
+            result.push_back(candidate.id);
+    }
+
+    int size() const { return ids.size(); }
+
+private:
+    struct Candidate
+    {
+        double squaredDistance;
+        int id;
+
+        bool operator<(const Candidate &other) const
+        {
+            return squaredDistance < other.squaredDistance || (squaredDistance == other.squaredDistance && id < other.id);
+        }
+    };
+
+    static double coordinate(const Point &point, int axis) { return axis == 0 ? point.x : point.y; }
+
+    /// Splits [from, to) on the median of its widest axis; the halves are built in parallel near the root.
+    void build(const vector<Point> &points, int from, int to, int parallelDepth)
+    {
+        if (to - from <= 1)
+        {
+            if (to > from)
+                axes[from] = 0;
+            return;
+        }
+
+        auto [minimumX, maximumX] = std::minmax_element(ids.begin() + from, ids.begin() + to, [&points](int first, int second)
+                                                        { return points[first].x < points[second].x; });
+        auto [minimumY, maximumY] = std::minmax_element(ids.begin() + from, ids.begin() + to, [&points](int first, int second)
+                                                        { return points[first].y < points[second].y; });
+        const int axis = points[*maximumX].x - points[*minimumX].x >= points[*maximumY].y - points[*minimumY].y ? 0 : 1;
+
+        const int middle = (from + to) / 2;
+        std::nth_element(ids.begin() + from, ids.begin() + middle, ids.begin() + to, [&points, axis](int first, int second)
+                         { return coordinate(points[first], axis) < coordinate(points[second], axis); });
+        axes[middle] = axis;
+
+        if (parallelDepth > 0)
+        {
+            auto left = std::async(std::launch::async, [&]
+                                   { build(points, from, middle, parallelDepth - 1); });
+            build(points, middle + 1, to, parallelDepth - 1);
+            left.get();
+        }
+        else
+        {
+            build(points, from, middle, 0);
+            build(points, middle + 1, to, 0);
+        }
+    }
+
+    void search(const Point &query, int count, int excludedId, int from, int to, vector<Candidate> &heap) const
+    {
+        if (from >= to)
+            return;
+
+        const int middle = (from + to) / 2;
+        const Point &point = treePoints[middle];
+        const double squaredDistance = (point.x - query.x) * (point.x - query.x) + (point.y - query.y) * (point.y - query.y);
+
+        if (ids[middle] != excludedId)
+        {
+            Candidate candidate{squaredDistance, ids[middle]};
+            if (static_cast<int>(heap.size()) < count)
+            {
+                heap.push_back(candidate);
+                std::push_heap(heap.begin(), heap.end());
+            }
+            else if (candidate < heap.front())
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = candidate;
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+
+        const double difference = coordinate(query, axes[middle]) - coordinate(point, axes[middle]);
+        const bool queryBefore = difference < 0;
+        search(query, count, excludedId, queryBefore ? from : middle + 1, queryBefore ? middle : to, heap);
+        if (static_cast<int>(heap.size()) < count || difference * difference <= heap.front().squaredDistance)
+            search(query, count, excludedId, queryBefore ? middle + 1 : from, queryBefore ? to : middle, heap);
+    }
+
+    vector<int> ids;
+    vector<Point> treePoints;
+    vector<char> axes;
+};
+
+/// The <<k>> nearest neighbours of every point, closest first, in one flat array (neighbours of point
+/// p in [p * k, (p + 1) * k)). Both the k-d tree and the queries run on <<threadCount>> threads.
+class CandidateLists
+{
+
+public:
+    CandidateLists() = delete;
+    CandidateLists(const vector<Point> &points, int kParam, int threadCount = std::thread::hardware_concurrency())
+        : k(std::min<int>(kParam, points.size() > 0 ? points.size() - 1 : 0)), elementCount(points.size())
+    {
+        if (kParam < 0)
+            throw InvalidNeighbourCountException();
+
+        threadCount = std::max(threadCount, 1);
+        KdTree tree(points, threadCount);
+        neighbours.resize(points.size() * k);
+
+        auto fill = [&](int thread)
+        {
+            vector<int> nearest;
+            for (int id = thread * elementCount / threadCount; id < (thread + 1) * elementCount / threadCount; id++)
+            {
+                tree.nearest(points[id], k, id, nearest);
+                std::copy(nearest.begin(), nearest.end(), neighbours.begin() + static_cast<size_t>(id) * k);
+            }
+        };
+
+        vector<std::thread> threads;
+        for (int thread = 1; thread < threadCount; thread++)
+            threads.emplace_back(fill, thread);
+        fill(0);
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    span<const int> of(int id) const
+    {
+        return span<const int>(neighbours.data() + static_cast<size_t>(id) * k, k);
+    }
+
+    int size() const { return elementCount; }
+    int neighboursPerElement() const { return k; }
+
+private:
+    int k;
+    int elementCount;
+    vector<int> neighbours;
+};
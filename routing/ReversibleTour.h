@@ -0,0 +1,305 @@
+#pragma once
+#include "TwoOpt.h"
+#include <vector>
+#include <random>
+#include <utility>
+#include <exception>
+using std::exception;
+using std::pair;
+using std::vector;
+
+class InvalidTourException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The tour elements must be distinct non negative ids.";
+    }
+};
+
+/// Route container that reverses any subsequence in O(log n) expected time. It is an implicit treap
+/// (ordered by position) whose nodes carry lazy reversal flags, so a reversal only swaps the flag of
+/// one subtree instead of moving the elements. Elements are ids and each node knows its parent, so
+/// the position of an element, its neighbours and the between query are also O(log n).
+class ReversibleTour
+{
+
+public:
+    ReversibleTour() = delete;
+    ReversibleTour(const vector<int> &route) : elements(route)
+    {
+        const int size = route.size();
+        left.assign(size, NONE);
+        right.assign(size, NONE);
+        parent.assign(size, NONE);
+        subtreeSize.assign(size, 1);
+        reversed.assign(size, false);
+        priority.resize(size);
+
+        for (int node = 0; node < size; node++)
+        {
+            if (elements[node] < 0)
+                throw InvalidTourException();
+            if (elements[node] >= static_cast<int>(nodeOf.size()))
+                nodeOf.resize(elements[node] + 1, NONE);
+            if (nodeOf[elements[node]] != NONE)
+                throw InvalidTourException();
+
+            nodeOf[elements[node]] = node;
+        }
+
+        std::mt19937 generator(size);
+        for (auto &value : priority)
+            value = generator();
+
+        root = build();
+    }
+
+    int size() const { return elements.size(); }
+
+    /// Element at the given position. Positions are not validated.
+    int operator[](int position) const
+    {
+        int node = root;
+        bool flipped = false;
+
+        while (true)
+        {
+            flipped ^= reversed[node];
+            const int before = flipped ? right[node] : left[node];
+            const int beforeSize = sizeOf(before);
+
+            if (position == beforeSize)
+                return elements[node];
+
+            if (position < beforeSize)
+                node = before;
+            else
+            {
+                position -= beforeSize + 1;
+                node = flipped ? left[node] : right[node];
+            }
+        }
+    }
+
+    /// Current position of an element. Elements are not validated.
+    int positionOf(int element) const
+    {
+        int node = nodeOf[element];
+        vector<int> &path = pathBuffer;
+        path.clear();
+        for (int current = node; current != NONE; current = parent[current])
+            path.push_back(current);
+
+        int position = 0;
+        bool flipped = false;
+        for (int i = path.size() - 1; i > 0; i--)
+        {
+            const int current = path[i];
+            flipped ^= reversed[current];
+            const int after = flipped ? left[current] : right[current];
+
+            if (path[i - 1] == after)
+                position += sizeOf(flipped ? right[current] : left[current]) + 1;
+        }
+
+        flipped ^= reversed[node];
+        return position + sizeOf(flipped ? right[node] : left[node]);
+    }
+
+    /// Element that follows <<element>> in the route, or -1 for the last one.
+    int next(int element) const
+    {
+        const int position = positionOf(element);
+        return position + 1 < size() ? (*this)[position + 1] : NONE;
+    }
+
+    /// Element that precedes <<element>> in the route, or -1 for the first one.
+    int prev(int element) const
+    {
+        const int position = positionOf(element);
+        return position > 0 ? (*this)[position - 1] : NONE;
+    }
+
+    /// Whether <<middle>> is visited when the route is walked (cyclically) from <<from>> to <<to>>.
+    bool between(int from, int middle, int to) const
+    {
+        const int fromPosition = positionOf(from);
+        const int middlePosition = positionOf(middle);
+        const int toPosition = positionOf(to);
+
+        if (fromPosition <= toPosition)
+            return fromPosition <= middlePosition && middlePosition <= toPosition;
+
+        return middlePosition >= fromPosition || middlePosition <= toPosition;
+    }
+
+    /// Reverses the elements between positions <<first>> and <<last>>, both included.
+    void reverse(int first, int last)
+    {
+        if (first >= last)
+            return;
+
+        auto [head, rest] = split(root, first);
+        auto [middle, tail] = split(rest, last - first + 1);
+        reversed[middle] = !reversed[middle];
+        root = merge(merge(head, middle), tail);
+        parent[root] = NONE;
+    }
+
+    vector<int> toVector() const
+    {
+        vector<int> route;
+        route.reserve(size());
+
+        vector<pair<int, bool>> &stack = stackBuffer;
+        stack.clear();
+        int node = root;
+        bool flipped = false;
+
+        while (node != NONE || !stack.empty())
+        {
+            while (node != NONE)
+            {
+                flipped ^= reversed[node];
+                stack.push_back({node, flipped});
+                node = flipped ? right[node] : left[node];
+            }
+
+            auto [current, currentFlipped] = stack.back();
+            stack.pop_back();
+            route.push_back(elements[current]);
+            flipped = currentFlipped;
+            node = flipped ? left[current] : right[current];
+        }
+
+        return route;
+    }
+
+private:
+    static constexpr int NONE = -1;
+
+    int sizeOf(int node) const { return node == NONE ? 0 : subtreeSize[node]; }
+
+    void update(int node)
+    {
+        subtreeSize[node] = 1 + sizeOf(left[node]) + sizeOf(right[node]);
+        if (left[node] != NONE)
+            parent[left[node]] = node;
+        if (right[node] != NONE)
+            parent[right[node]] = node;
+    }
+
+    void push(int node)
+    {
+        if (!reversed[node])
+            return;
+
+        std::swap(left[node], right[node]);
+        if (left[node] != NONE)
+            reversed[left[node]] = !reversed[left[node]];
+        if (right[node] != NONE)
+            reversed[right[node]] = !reversed[right[node]];
+        reversed[node] = false;
+    }
+
+    /// Splits the tree in the first <<count>> elements and the remaining ones.
+    pair<int, int> split(int node, int count)
+    {
+        if (node == NONE)
+            return {NONE, NONE};
+
+        push(node);
+        if (sizeOf(left[node]) >= count)
+        {
+            auto [head, tail] = split(left[node], count);
+            left[node] = tail;
+            update(node);
+            if (head != NONE)
+                parent[head] = NONE;
+            return {head, node};
+        }
+
+        auto [head, tail] = split(right[node], count - sizeOf(left[node]) - 1);
+        right[node] = head;
+        update(node);
+        if (tail != NONE)
+            parent[tail] = NONE;
+        return {node, tail};
+    }
+
+    int merge(int head, int tail)
+    {
+        if (head == NONE)
+            return tail;
+        if (tail == NONE)
+            return head;
+
+        if (priority[head] > priority[tail])
+        {
+            push(head);
+            right[head] = merge(right[head], tail);
+            update(head);
+            return head;
+        }
+
+        push(tail);
+        left[tail] = merge(head, left[tail]);
+        update(tail);
+        return tail;
+    }
+
+    /// Builds the treap of the initial route in linear time (Cartesian tree construction).
+    int build()
+    {
+        vector<int> spine;
+        for (int node = 0; node < size(); node++)
+        {
+            int last = NONE;
+            while (!spine.empty() && priority[spine.back()] < priority[node])
+            {
+                last = spine.back();
+                spine.pop_back();
+                update(last);
+            }
+
+            left[node] = last;
+            if (!spine.empty())
+                right[spine.back()] = node;
+            spine.push_back(node);
+        }
+
+        for (int i = spine.size() - 1; i >= 0; i--)
+            update(spine[i]);
+
+        if (spine.empty())
+            return NONE;
+
+        parent[spine.front()] = NONE;
+        return spine.front();
+    }
+
+    vector<int> elements;
+    vector<int> nodeOf;
+    vector<int> left;
+    vector<int> right;
+    vector<int> parent;
+    vector<int> subtreeSize;
+    vector<unsigned> priority;
+    vector<bool> reversed;
+    int root{NONE};
+    mutable vector<int> pathBuffer;
+    mutable vector<pair<int, bool>> stackBuffer;
+};
+
+inline void twoOptUnchecked(ReversibleTour &route, int firstIndex, int secondIndex) noexcept
+{
+    route.reverse(firstIndex + 1, secondIndex - 1);
+}
+
+/// Same as twoOpt(vector<int> &, int, int), with the same validation, but in O(log n).
+inline void twoOpt(ReversibleTour &route, int firstIndex, int secondIndex)
+{
+    validateTwoOptIndices(route.size(), firstIndex, secondIndex);
+
+    twoOptUnchecked(route, firstIndex, secondIndex);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "TwoOpt.h"
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+using std::begin;
+using std::exception;
+using std::size_t;
+using std::vector;
+
+class InvalidThirdIndexException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "Invalid third index exception. This index must reference an element of the route after both modified segments";
+    }
+};
+
+class InvalidSegmentLengthException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The or-opt segment must have between one and three elements.";
+    }
+};
+
+/// Ways of reconnecting the two segments of a three-opt move where all three removed edges are replaced.
+enum ThreeOptReconnection
+{
+    SWAP_SEGMENTS,
+    SWAP_REVERSE_FIRST,
+    SWAP_REVERSE_SECOND,
+    REVERSE_BOTH
+};
+
+inline void validateThreeOptIndices(size_t routeSize, int firstIndex, int secondIndex, int thirdIndex)
+{
+    if (routeSize < 4)
+        throw TooShortRouteException();
+
+    if (firstIndex < 0 || firstIndex >= secondIndex)
+        throw InvalidFirstIndexException();
+    // Both segments must have at least one element
+    if (secondIndex >= thirdIndex - 1)
+        throw InvalidSecondIndexException();
+    if (static_cast<size_t>(thirdIndex) >= routeSize)
+        throw InvalidThirdIndexException();
+}
+
+inline void threeOpt(vector<int> &route, int firstIndex, int secondIndex, int thirdIndex, ThreeOptReconnection reconnection)
+{
+    /**
+     * This function alters the route R, reconnecting the segments S1 = ]<<firstIndex>>, <<secondIndex>>]
+     * and S2 = ]<<secondIndex>>, <<thirdIndex>>[. The elements referenced by <<firstIndex>> and
+     * <<thirdIndex>> keep their positions.
+     * Ex:
+     *    Original route R = A -- B -- C -- D -- E -- F, firstIndex = 0, secondIndex = 2, thirdIndex = 5
+     *    SWAP_SEGMENTS        A -- D -- E -- B -- C -- F
+     *    SWAP_REVERSE_FIRST   A -- D -- E -- C -- B -- F
+     *    SWAP_REVERSE_SECOND  A -- E -- D -- B -- C -- F
+     *    REVERSE_BOTH         A -- C -- B -- E -- D -- F
+     */
+
+    validateThreeOptIndices(route.size(), firstIndex, secondIndex, thirdIndex);
+
+    auto first = begin(route) + firstIndex + 1;
+    auto second = begin(route) + secondIndex + 1;
+    auto third = begin(route) + thirdIndex;
+
+    if (reconnection == SWAP_REVERSE_FIRST || reconnection == REVERSE_BOTH)
+        std::reverse(first, second);
+    if (reconnection == SWAP_REVERSE_SECOND || reconnection == REVERSE_BOTH)
+        std::reverse(second, third);
+    if (reconnection != REVERSE_BOTH)
+        std::rotate(first, second, third);
+}
+
+inline void orOpt(vector<int> &route, int segmentStart, int segmentLength, int insertionIndex, bool reversed = false)
+{
+    /**
+     * This function moves the segment of <<segmentLength>> elements starting at <<segmentStart>> between
+     * the element referenced by <<insertionIndex>> and its successor, optionally reversing it. As in
+     * twoOpt, the first and the last elements of the route never move.
+     * Ex:
+     *    Original route R = A -- B -- C -- D -- E -- F, segmentStart = 1, segmentLength = 2, insertionIndex = 4
+     *    Final route    R = A -- D -- E -- B -- C -- F
+     */
+
+    if (segmentLength < 1 || segmentLength > 3)
+        throw InvalidSegmentLengthException();
+    if (route.size() < 4)
+        throw TooShortRouteException();
+
+    const int size = route.size();
+    const int segmentEnd = segmentStart + segmentLength - 1;
+    if (segmentStart < 1 || segmentEnd >= size - 1)
+        throw InvalidFirstIndexException();
+    if (insertionIndex < 0 || insertionIndex >= size - 1 || (insertionIndex >= segmentStart - 1 && insertionIndex <= segmentEnd))
+        throw InvalidSecondIndexException();
+
+    if (insertionIndex > segmentEnd)
+        threeOpt(route, segmentStart - 1, segmentEnd, insertionIndex + 1, reversed ? SWAP_REVERSE_FIRST : SWAP_SEGMENTS);
+    else
+        threeOpt(route, insertionIndex, segmentStart - 1, segmentEnd + 1, reversed ? SWAP_REVERSE_SECOND : SWAP_SEGMENTS);
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+#include <span>
+using std::begin;
+using std::exception;
+using std::reverse;
+using std::size_t;
+using std::span;
+using std::vector;
+
+class InvalidFirstIndexException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "Invalid first index exception. This index must reference an element before both the modified interval (that has minimum size 2) and the second index";
+    }
+};
+
+class InvalidSecondIndexException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "Invalid second index exception. This index must reference an element after both the modified interval (that has minimum size 2) and the first index";
+    }
+};
+
+class TooShortRouteException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The route must have a size greater than 3 to apply a two-opt.";
+    }
+};
+
+class TooShortTwoOptRangeException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The two opt range must have a minimum size greater than one.";
+    }
+};
+
+/// Moves with a smaller length decrease are not considered improvements (floating point noise).
+constexpr double MINIMUM_TWO_OPT_GAIN = 1e-9;
+
+struct TwoOptMove
+{
+    int firstIndex;
+    int secondIndex;
+    double gain;
+
+    bool isImproving() const { return firstIndex >= 0; }
+};
+
+/// Result of the non throwing two-opt functions. Each error matches one of the exceptions above.
+enum TwoOptStatus
+{
+    VALID_TWO_OPT,
+    TOO_SHORT_ROUTE,
+    INVALID_FIRST_INDEX,
+    INVALID_SECOND_INDEX,
+    TOO_SHORT_TWO_OPT_RANGE,
+    OVERLAPPING_TWO_OPT_MOVES
+};
+
+/// Same rules as twoOpt. On success the indices are swapped if needed so that firstIndex < secondIndex.
+inline TwoOptStatus checkTwoOptIndices(size_t routeSize, int &firstIndex, int &secondIndex) noexcept
+{
+    if (secondIndex < firstIndex)
+        std::swap(secondIndex, firstIndex);
+
+    if (routeSize < 4)
+        return TOO_SHORT_ROUTE;
+
+    if (firstIndex < 0 || static_cast<size_t>(firstIndex) >= routeSize - 2)
+        return INVALID_FIRST_INDEX;
+    if (secondIndex < 3 || static_cast<size_t>(secondIndex) >= routeSize)
+        return INVALID_SECOND_INDEX;
+
+    // It must have at least two elements between the two-opt extremities
+    if (secondIndex <= firstIndex + 2)
+        return TOO_SHORT_TWO_OPT_RANGE;
+
+    return VALID_TWO_OPT;
+}
+
+inline void validateTwoOptIndices(size_t routeSize, int &firstIndex, int &secondIndex)
+{
+    switch (checkTwoOptIndices(routeSize, firstIndex, secondIndex))
+    {
+    case TOO_SHORT_ROUTE:
+        throw TooShortRouteException();
+    case INVALID_FIRST_INDEX:
+        throw InvalidFirstIndexException();
+    case INVALID_SECOND_INDEX:
+        throw InvalidSecondIndexException();
+    case TOO_SHORT_TWO_OPT_RANGE:
+        throw TooShortTwoOptRangeException();
+    default:
+        return;
+    }
+}
+
+/// Fast path for moves that were already validated: <<firstIndex>> must be smaller than <<secondIndex>>.
+inline void twoOptUnchecked(vector<int> &route, int firstIndex, int secondIndex) noexcept
+{
+    std::reverse(begin(route) + firstIndex + 1, begin(route) + secondIndex);
+}
+
+inline void twoOpt(vector<int> &route, int firstIndex, int secondIndex)
+{
+    /**
+     * This function alters the route R, inverting the subsequence delimited by <<firstIndex>> and
+     * <<secondIndex>>. After this invertion the element referenced by <<firstIndex>> will be succeded
+     * by the one that preceeds that referenced by <<secondIndex>>, and element referenced by
+     * <<secondIndex>> will be preceeded by the one the succeded the one referenced by <<firstIndex>>.
+     * Ex:
+     *    Original route R = A -- B -- C -- D -- E -- F, firstIndex = 1, secondIndex = 4
+     *                        firstIndex    secondIndex
+     *    Final route    R = A -- B -- D -- C -- E -- F
+     */
+
+    validateTwoOptIndices(route.size(), firstIndex, secondIndex);
+
+    twoOptUnchecked(route, firstIndex, secondIndex);
+}
+
+/// Non throwing twoOpt. The route is only changed when the returned status is VALID_TWO_OPT.
+inline TwoOptStatus tryTwoOpt(vector<int> &route, int firstIndex, int secondIndex) noexcept
+{
+    const TwoOptStatus status = checkTwoOptIndices(route.size(), firstIndex, secondIndex);
+    if (status == VALID_TWO_OPT)
+        twoOptUnchecked(route, firstIndex, secondIndex);
+
+    return status;
+}
+
+/// Applies several moves in a single pass. The moves must be sorted along the route and must not
+/// overlap (the second index of a move is at most the first index of the next one), so each of them
+/// has the same effect, and the same gain, as if it was applied alone. Every move is validated before
+/// the route is changed: on error nothing is applied.
+inline TwoOptStatus applyTwoOptMoves(vector<int> &route, span<const TwoOptMove> moves) noexcept
+{
+    int previousSecondIndex = 0;
+    for (const TwoOptMove &move : moves)
+    {
+        int firstIndex = move.firstIndex;
+        int secondIndex = move.secondIndex;
+        const TwoOptStatus status = checkTwoOptIndices(route.size(), firstIndex, secondIndex);
+        if (status != VALID_TWO_OPT)
+            return status;
+        if (firstIndex < previousSecondIndex)
+            return OVERLAPPING_TWO_OPT_MOVES;
+
+        previousSecondIndex = secondIndex;
+    }
+
+    for (const TwoOptMove &move : moves)
+        twoOptUnchecked(route, std::min(move.firstIndex, move.secondIndex), std::max(move.firstIndex, move.secondIndex));
+
+    return VALID_TWO_OPT;
+}
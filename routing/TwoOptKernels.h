@@ -0,0 +1,278 @@
+#pragma once
+#include "TwoOpt.h"
+#include "DistanceMatrix.h"
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <utility>
+using std::size_t;
+using std::span;
+using std::vector;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TWO_OPT_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+/// Batch scoring of two-opt moves over a DistanceMatrix. Every kernel has a scalar and an AVX2
+/// version returning exactly the same values; the functions outside the nested namespaces pick the
+/// AVX2 one at runtime when the processor supports it.
+namespace TwoOptKernels
+{
+    inline bool avx2Supported()
+    {
+#ifdef TWO_OPT_AVX2_KERNELS
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    /// edges[k] = length of the edge arriving at route[k] (edges[0] is zero).
+    inline void routeEdges(const int *route, int size, const DistanceMatrix &distances, vector<double> &edges)
+    {
+        edges.resize(size + 4);
+        edges[0] = 0;
+        for (int k = 1; k < size; k++)
+            edges[k] = distances(route[k - 1], route[k]);
+    }
+
+    namespace scalar
+    {
+        inline void evaluateGains(const int *route, const DistanceMatrix &distances, const int *firstIndices,
+                                  const int *secondIndices, size_t count, double *gains)
+        {
+            for (size_t k = 0; k < count; k++)
+            {
+                const int before = route[firstIndices[k]];
+                const int first = route[firstIndices[k] + 1];
+                const int last = route[secondIndices[k] - 1];
+                const int after = route[secondIndices[k]];
+
+                gains[k] = distances(before, first) + distances(last, after) - distances(before, last) - distances(first, after);
+            }
+        }
+
+        inline TwoOptMove bestMove(const int *route, int size, const DistanceMatrix &distances, const double *edges)
+        {
+            TwoOptMove best{-1, -1, MINIMUM_TWO_OPT_GAIN};
+
+            for (int firstIndex = 0; firstIndex + 3 < size; firstIndex++)
+            {
+                const double *beforeRow = distances.data() + static_cast<size_t>(route[firstIndex]) * distances.size();
+                const double *firstRow = distances.data() + static_cast<size_t>(route[firstIndex + 1]) * distances.size();
+                const double removedFirstEdge = edges[firstIndex + 1];
+
+                for (int secondIndex = firstIndex + 3; secondIndex < size; secondIndex++)
+                {
+                    const double gain = removedFirstEdge + edges[secondIndex] - beforeRow[route[secondIndex - 1]] - firstRow[route[secondIndex]];
+                    if (gain > best.gain)
+                        best = TwoOptMove{firstIndex, secondIndex, gain};
+                }
+            }
+
+            return best;
+        }
+    }
+
+#ifdef TWO_OPT_AVX2_KERNELS
+    namespace avx2
+    {
+        __attribute__((target("avx2"))) inline __m256i flatOffsets(__m128i from, __m128i to, __m256i dimension)
+        {
+            return _mm256_add_epi64(_mm256_mul_epu32(_mm256_cvtepu32_epi64(from), dimension), _mm256_cvtepu32_epi64(to));
+        }
+
+        /// base[indices[i]] for the 4 lanes. The masked gather with every lane set is the plain one, but
+        /// it starts from zeros: GCC warns about the undefined source of _mm256_i32gather_pd.
+        __attribute__((target("avx2"))) inline __m256d gatherDoubles(const double *base, __m128i indices)
+        {
+            return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, indices, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+        }
+
+        __attribute__((target("avx2"))) inline void evaluateGains(const int *route, const DistanceMatrix &distances, const int *firstIndices,
+                                                                  const int *secondIndices, size_t count, double *gains)
+        {
+            const double *data = distances.data();
+            const __m256i dimension = _mm256_set1_epi64x(distances.size());
+            const __m128i one = _mm_set1_epi32(1);
+            size_t k = 0;
+
+            for (; k + 4 <= count; k += 4)
+            {
+                const __m128i firstIndex = _mm_loadu_si128(reinterpret_cast<const __m128i *>(firstIndices + k));
+                const __m128i secondIndex = _mm_loadu_si128(reinterpret_cast<const __m128i *>(secondIndices + k));
+                const __m128i before = _mm_i32gather_epi32(route, firstIndex, 4);
+                const __m128i first = _mm_i32gather_epi32(route, _mm_add_epi32(firstIndex, one), 4);
+                const __m128i last = _mm_i32gather_epi32(route, _mm_sub_epi32(secondIndex, one), 4);
+                const __m128i after = _mm_i32gather_epi32(route, secondIndex, 4);
+
+                const __m256d beforeFirst = _mm256_i64gather_pd(data, flatOffsets(before, first, dimension), 8);
+                const __m256d lastAfter = _mm256_i64gather_pd(data, flatOffsets(last, after, dimension), 8);
+                const __m256d beforeLast = _mm256_i64gather_pd(data, flatOffsets(before, last, dimension), 8);
+                const __m256d firstAfter = _mm256_i64gather_pd(data, flatOffsets(first, after, dimension), 8);
+
+                const __m256d gain = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(beforeFirst, lastAfter), beforeLast), firstAfter);
+                _mm256_storeu_pd(gains + k, gain);
+            }
+
+            scalar::evaluateGains(route, distances, firstIndices + k, secondIndices + k, count - k, gains + k);
+        }
+
+        /// d(route[rowIndex], route[j]) for every j from <<from>>, gathered from the matrix row.
+        __attribute__((target("avx2"))) inline void gatherRow(const int *route, int size, const DistanceMatrix &distances, int rowIndex,
+                                                              int from, double *row)
+        {
+            const double *matrixRow = distances.data() + static_cast<size_t>(route[rowIndex]) * distances.size();
+            int j = from;
+            for (; j + 4 <= size; j += 4)
+                _mm256_storeu_pd(row + j, gatherDoubles(matrixRow, _mm_loadu_si128(reinterpret_cast<const __m128i *>(route + j))));
+            for (; j < size; j++)
+                row[j] = matrixRow[route[j]];
+        }
+
+        /// Scores 4 candidates from <<secondIndex>> and keeps, in each lane, the best gain and the
+        /// smallest second index reaching it. Stores the gathered distances in firstRow.
+        __attribute__((target("avx2"))) inline void scoreBlock(const int *route, const double *edges, const double *beforeRow,
+                                                               const double *firstMatrixRow, double *firstRow, int secondIndex,
+                                                               __m256d removedFirstEdge, __m256d &laneGain, __m256d &laneIndex)
+        {
+            const __m128i after = _mm_loadu_si128(reinterpret_cast<const __m128i *>(route + secondIndex));
+            const __m256d beforeLast = _mm256_loadu_pd(beforeRow + secondIndex - 1);
+            const __m256d firstAfter = gatherDoubles(firstMatrixRow, after);
+            const __m256d lastAfter = _mm256_loadu_pd(edges + secondIndex);
+            _mm256_storeu_pd(firstRow + secondIndex, firstAfter);
+
+            const __m256d gain = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(removedFirstEdge, lastAfter), beforeLast), firstAfter);
+            const __m256d improved = _mm256_cmp_pd(gain, laneGain, _CMP_GT_OQ);
+            const __m256d secondIndices = _mm256_add_pd(_mm256_set1_pd(secondIndex), _mm256_setr_pd(0, 1, 2, 3));
+            laneGain = _mm256_blendv_pd(laneGain, gain, improved);
+            laneIndex = _mm256_blendv_pd(laneIndex, secondIndices, improved);
+        }
+
+        /// Row firstIndex + 1 of the route-ordered matrix, gathered to score the moves of firstIndex,
+        /// is row "before" of firstIndex + 1: it is kept, so every candidate needs one gathered
+        /// distance instead of two. The matrix row of the next first index is read at random, in the
+        /// order of the route, so it is prefetched sequentially while the current one is scored.
+        __attribute__((target("avx2"))) inline TwoOptMove bestMove(const int *route, int size, const DistanceMatrix &distances, const double *edges)
+        {
+            TwoOptMove best{-1, -1, MINIMUM_TWO_OPT_GAIN};
+            if (size < 4)
+                return best;
+
+            // beforeRow[j] = d(route[firstIndex], route[j]), firstRow[j] = d(route[firstIndex + 1], route[j])
+            thread_local vector<double> rows;
+            rows.resize(2 * static_cast<size_t>(size));
+            double *beforeRow = rows.data();
+            double *firstRow = rows.data() + size;
+            gatherRow(route, size, distances, 0, 2, beforeRow);
+            const size_t rowBytes = distances.size() * sizeof(double);
+
+            for (int firstIndex = 0; firstIndex + 3 < size; firstIndex++)
+            {
+                const double *firstMatrixRow = distances.data() + static_cast<size_t>(route[firstIndex + 1]) * distances.size();
+                const __m256d removedFirstEdge = _mm256_set1_pd(edges[firstIndex + 1]);
+                const char *nextMatrixRow = reinterpret_cast<const char *>(distances.data() + static_cast<size_t>(route[firstIndex + 2]) * distances.size());
+                size_t prefetched = 0;
+
+                // Two independent sets of lanes, so that the comparisons of a block do not wait for the previous one
+                __m256d laneGains[2] = {_mm256_set1_pd(best.gain), _mm256_set1_pd(best.gain)};
+                __m256d laneIndices[2] = {_mm256_set1_pd(-1), _mm256_set1_pd(-1)};
+
+                // Also needed by the next first index, from its second index minus one
+                firstRow[firstIndex + 2] = firstMatrixRow[route[firstIndex + 2]];
+
+                int secondIndex = firstIndex + 3;
+                for (; secondIndex + 8 <= size; secondIndex += 8)
+                {
+                    scoreBlock(route, edges, beforeRow, firstMatrixRow, firstRow, secondIndex, removedFirstEdge, laneGains[0], laneIndices[0]);
+                    scoreBlock(route, edges, beforeRow, firstMatrixRow, firstRow, secondIndex + 4, removedFirstEdge, laneGains[1], laneIndices[1]);
+                    for (int line = 0; line < 2 && prefetched < rowBytes; line++, prefetched += 64)
+                        _mm_prefetch(nextMatrixRow + prefetched, _MM_HINT_T0);
+                }
+                if (secondIndex + 4 <= size)
+                {
+                    scoreBlock(route, edges, beforeRow, firstMatrixRow, firstRow, secondIndex, removedFirstEdge, laneGains[0], laneIndices[0]);
+                    secondIndex += 4;
+                }
+                for (; prefetched < rowBytes; prefetched += 64)
+                    _mm_prefetch(nextMatrixRow + prefetched, _MM_HINT_T0);
+
+                alignas(32) double gains[8];
+                alignas(32) double indices[8];
+                _mm256_store_pd(gains, laneGains[0]);
+                _mm256_store_pd(gains + 4, laneGains[1]);
+                _mm256_store_pd(indices, laneIndices[0]);
+                _mm256_store_pd(indices + 4, laneIndices[1]);
+
+                TwoOptMove rowBest{-1, -1, best.gain};
+                for (int lane = 0; lane < 8; lane++)
+                {
+                    if (indices[lane] < 0)
+                        continue;
+                    if (gains[lane] > rowBest.gain || (gains[lane] == rowBest.gain && indices[lane] < rowBest.secondIndex))
+                        rowBest = TwoOptMove{firstIndex, static_cast<int>(indices[lane]), gains[lane]};
+                }
+
+                const double removedFirstEdgeValue = edges[firstIndex + 1];
+                for (; secondIndex < size; secondIndex++)
+                {
+                    firstRow[secondIndex] = firstMatrixRow[route[secondIndex]];
+                    const double gain = removedFirstEdgeValue + edges[secondIndex] - beforeRow[secondIndex - 1] - firstRow[secondIndex];
+                    if (gain > rowBest.gain)
+                        rowBest = TwoOptMove{firstIndex, secondIndex, gain};
+                }
+
+                if (rowBest.isImproving())
+                    best = rowBest;
+                std::swap(beforeRow, firstRow);
+            }
+
+            return best;
+        }
+    }
+#endif
+
+    /// gains[k] = length decrease of twoOpt(route, firstIndices[k], secondIndices[k]). Indices are not validated.
+    inline void evaluateGains(const vector<int> &route, const DistanceMatrix &distances, span<const int> firstIndices,
+                              span<const int> secondIndices, span<double> gains)
+    {
+#ifdef TWO_OPT_AVX2_KERNELS
+        if (avx2Supported())
+            return avx2::evaluateGains(route.data(), distances, firstIndices.data(), secondIndices.data(), gains.size(), gains.data());
+#endif
+        scalar::evaluateGains(route.data(), distances, firstIndices.data(), secondIndices.data(), gains.size(), gains.data());
+    }
+
+    /// Best move among the given candidates, or a move with negative indices if none is improving.
+    /// Ties are broken in favour of the candidate that comes first.
+    inline TwoOptMove findBestMove(const vector<int> &route, const DistanceMatrix &distances, span<const int> firstIndices,
+                                   span<const int> secondIndices)
+    {
+        thread_local vector<double> gains;
+        gains.resize(firstIndices.size());
+        evaluateGains(route, distances, firstIndices, secondIndices, gains);
+
+        TwoOptMove best{-1, -1, MINIMUM_TWO_OPT_GAIN};
+        for (size_t k = 0; k < gains.size(); k++)
+            if (gains[k] > best.gain)
+                best = TwoOptMove{firstIndices[k], secondIndices[k], gains[k]};
+
+        return best;
+    }
+
+    /// Best move of the whole two-opt neighbourhood of the route, scanned in the same order as
+    /// TwoOptSearch so both return the same move.
+    inline TwoOptMove findBestMove(const vector<int> &route, const DistanceMatrix &distances)
+    {
+        thread_local vector<double> edges;
+        routeEdges(route.data(), route.size(), distances, edges);
+
+#ifdef TWO_OPT_AVX2_KERNELS
+        if (avx2Supported())
+            return avx2::bestMove(route.data(), route.size(), distances, edges.data());
+#endif
+        return scalar::bestMove(route.data(), route.size(), distances, edges.data());
+    }
+}
@@ -0,0 +1,263 @@
+#pragma once
+#include "TwoOpt.h"
+#include "DistanceMatrix.h"
+#include "TwoOptKernels.h"
+#include "NeighbourLists.h"
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+using std::size_t;
+using std::vector;
+
+enum ImprovementMode
+{
+    FIRST_IMPROVEMENT,
+    BEST_IMPROVEMENT
+};
+
+/// Local search that applies improving two-opt moves until the route reaches a local optimum.
+/// <<Distance>> is any callable returning the (symmetric) distance between two route elements, so it
+/// can be a DistanceMatrix, a reference to one (TwoOptSearch<const DistanceMatrix &>), a lambda or a
+/// std::function. Each candidate is scored in constant time from the two removed and the two added
+/// edges. Only improving moves are applied, through twoOptUnchecked since the scans only generate
+/// valid moves. Routes can be a vector<int> or any container with a twoOptUnchecked overload, such as
+/// ReversibleTour.
+/// Best-improvement scans of a vector<int> over a DistanceMatrix use the batch TwoOptKernels.
+template <class Distance>
+class TwoOptSearch
+{
+
+public:
+    static constexpr double MINIMUM_GAIN = MINIMUM_TWO_OPT_GAIN;
+
+    TwoOptSearch(Distance distanceParam, ImprovementMode modeParam = FIRST_IMPROVEMENT)
+        : distance(std::move(distanceParam)), mode(modeParam) {}
+
+    /// Length decrease obtained by applying twoOpt(route, firstIndex, secondIndex). Indices are not validated.
+    template <class Route>
+    double moveGain(const Route &route, int firstIndex, int secondIndex) const
+    {
+        const int before = route[firstIndex];
+        const int first = route[firstIndex + 1];
+        const int last = route[secondIndex - 1];
+        const int after = route[secondIndex];
+
+        return distance(before, first) + distance(last, after) - distance(before, last) - distance(first, after);
+    }
+
+    template <class Route>
+    double length(const Route &route) const
+    {
+        double total{};
+        for (int i = 0; i + 1 < static_cast<int>(route.size()); i++)
+            total += distance(route[i], route[i + 1]);
+
+        return total;
+    }
+
+    /// Returns the first (or the best, depending on the mode) improving move. If there is none, the
+    /// returned move has negative indices.
+    template <class Route>
+    TwoOptMove findImprovingMove(const Route &route) const
+    {
+        TwoOptMove best{-1, -1, MINIMUM_GAIN};
+        const int size = route.size();
+
+        if constexpr (std::is_same_v<std::remove_cvref_t<Distance>, DistanceMatrix> && std::is_same_v<Route, vector<int>>)
+        {
+            if (mode == BEST_IMPROVEMENT)
+            {
+                evaluated += size < 4 ? 0 : static_cast<long long>(size - 3) * (size - 2) / 2;
+                return TwoOptKernels::findBestMove(route, distance);
+            }
+        }
+
+        for (int firstIndex = 0; firstIndex + 3 < size; firstIndex++)
+        {
+            const int before = route[firstIndex];
+            const int first = route[firstIndex + 1];
+            const double removedFirstEdge = distance(before, first);
+
+            for (int secondIndex = firstIndex + 3; secondIndex < size; secondIndex++)
+            {
+                const int last = route[secondIndex - 1];
+                const int after = route[secondIndex];
+                const double gain = removedFirstEdge + distance(last, after) - distance(before, last) - distance(first, after);
+
+                evaluated++;
+                if (gain > best.gain)
+                {
+                    best = TwoOptMove{firstIndex, secondIndex, gain};
+                    if (mode == FIRST_IMPROVEMENT)
+                        return best;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    /// Applies a single improving move, if any. Returns whether the route was changed.
+    template <class Route>
+    bool improve(Route &route)
+    {
+        TwoOptMove move = findImprovingMove(route);
+        if (!move.isImproving())
+            return false;
+
+        twoOptUnchecked(route, move.firstIndex, move.secondIndex);
+        applied++;
+        return true;
+    }
+
+    /// Improves the route until no improving move is left. Returns the number of applied moves.
+    /// In first-improvement mode the moves are applied as soon as they are found and the scan goes on
+    /// from the same position instead of restarting from the beginning of the route.
+    template <class Route>
+    long long optimize(Route &route)
+    {
+        const long long initiallyApplied = applied;
+
+        if (mode == BEST_IMPROVEMENT)
+        {
+            while (improve(route))
+                ;
+        }
+        else
+        {
+            while (sweep(route) > 0)
+                ;
+        }
+
+        return applied - initiallyApplied;
+    }
+
+    /// First-improvement search restricted to the moves that add an edge between an element and one
+    /// of its candidate neighbours, shorter than the edge it replaces. Every improving move has such an
+    /// edge, so only the ones that need a far neighbour are missed, and a pass costs O(n * k) instead of
+    /// O(n^2). Route elements must be the ids used by the candidate lists.
+    template <class Route>
+    long long optimize(Route &route, const CandidateLists &candidates)
+    {
+        const long long initiallyApplied = applied;
+        const int size = route.size();
+
+        if constexpr (std::is_same_v<Route, vector<int>>)
+        {
+            positions.assign(candidates.size(), -1);
+            for (int index = 0; index < size; index++)
+                positions[route[index]] = index;
+        }
+
+        auto positionOf = [this, &route](int element)
+        {
+            if constexpr (std::is_same_v<Route, vector<int>>)
+                return positions[element];
+            else
+                return route.positionOf(element);
+        };
+
+        auto tryMove = [&](int firstIndex, int secondIndex)
+        {
+            evaluated++;
+            if (moveGain(route, firstIndex, secondIndex) <= MINIMUM_GAIN)
+                return false;
+
+            twoOptUnchecked(route, firstIndex, secondIndex);
+            applied++;
+            if constexpr (std::is_same_v<Route, vector<int>>)
+                for (int index = firstIndex + 1; index < secondIndex; index++)
+                    positions[route[index]] = index;
+
+            return true;
+        };
+
+        bool improved = true;
+        while (improved)
+        {
+            improved = false;
+            for (int index = 0; index < size; index++)
+            {
+                const int element = route[index];
+
+                // For both edges of the element, the moves replacing it by a shorter edge to a neighbour
+                for (int side : {1, -1})
+                {
+                    const int adjacent = index + side;
+                    if (adjacent < 0 || adjacent >= size)
+                        continue;
+
+                    const double removedEdge = distance(element, route[adjacent]);
+                    for (int neighbour : candidates.of(element))
+                    {
+                        if (distance(element, neighbour) >= removedEdge)
+                            break;
+
+                        const int position = positionOf(neighbour);
+                        int firstIndex, secondIndex;
+                        if (side == 1)
+                        {
+                            firstIndex = position > index ? index : position;
+                            secondIndex = position > index ? position + 1 : index + 1;
+                        }
+                        else
+                        {
+                            firstIndex = position > index ? index - 1 : position - 1;
+                            secondIndex = position > index ? position : index;
+                        }
+
+                        if (firstIndex >= 0 && firstIndex + 3 <= secondIndex && secondIndex < size && tryMove(firstIndex, secondIndex))
+                        {
+                            improved = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        return applied - initiallyApplied;
+    }
+
+    long long evaluatedMoves() const { return evaluated; }
+    long long appliedMoves() const { return applied; }
+
+private:
+    template <class Route>
+    long long sweep(Route &route)
+    {
+        const long long initiallyApplied = applied;
+        const int size = route.size();
+
+        for (int firstIndex = 0; firstIndex + 3 < size; firstIndex++)
+        {
+            const int before = route[firstIndex];
+            double removedFirstEdge = distance(before, route[firstIndex + 1]);
+
+            for (int secondIndex = firstIndex + 3; secondIndex < size; secondIndex++)
+            {
+                const int first = route[firstIndex + 1];
+                const int last = route[secondIndex - 1];
+                const int after = route[secondIndex];
+                const double gain = removedFirstEdge + distance(last, after) - distance(before, last) - distance(first, after);
+
+                evaluated++;
+                if (gain > MINIMUM_GAIN)
+                {
+                    twoOptUnchecked(route, firstIndex, secondIndex);
+                    applied++;
+                    removedFirstEdge = distance(before, route[firstIndex + 1]);
+                }
+            }
+        }
+
+        return applied - initiallyApplied;
+    }
+
+    Distance distance;
+    ImprovementMode mode;
+    vector<int> positions;
+    mutable long long evaluated{};
+    long long applied{};
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+using std::size_t;
+using std::unique_ptr;
+using std::vector;
+
+/// Fixed set of worker threads running batches of independent tasks. Every worker owns a deque of
+/// task indices: it takes work from the back of its own deque and, once empty, steals from the front
+/// of the others, so uneven tasks (e.g. routes of different sizes) keep every core busy.
+class WorkStealingPool
+{
+
+public:
+    WorkStealingPool(int threadCount = std::thread::hardware_concurrency())
+    {
+        if (threadCount < 1)
+            threadCount = 1;
+
+        for (int worker = 0; worker < threadCount; worker++)
+            queues.push_back(std::make_unique<TaskQueue>());
+        for (int worker = 0; worker < threadCount; worker++)
+            threads.emplace_back([this, worker]
+                                 { workerLoop(worker); });
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    int size() const { return threads.size(); }
+
+    /// Calls task(index, worker) for every index in [0, count) and waits for all of them. <<worker>> is
+    /// the id (in [0, size())) of the thread running the task, to index per worker scratch data. The
+    /// first exception thrown by a task is rethrown here.
+    void run(size_t count, const std::function<void(size_t, int)> &task)
+    {
+        if (count == 0)
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for (size_t worker = 0; worker < queues.size(); worker++)
+        {
+            std::lock_guard<std::mutex> queueLock(queues[worker]->mutex);
+            for (size_t index = worker * count / queues.size(); index < (worker + 1) * count / queues.size(); index++)
+                queues[worker]->tasks.push_back(index);
+        }
+
+        currentTask = &task;
+        pending = count;
+        failure = nullptr;
+        batch++;
+        wakeUp.notify_all();
+        finished.wait(lock, [this]
+                      { return pending == 0 && active == 0; });
+        currentTask = nullptr;
+
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool takeTask(int worker, size_t &index)
+    {
+        {
+            TaskQueue &own = *queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                index = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t offset = 1; offset < queues.size(); offset++)
+        {
+            TaskQueue &victim = *queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                index = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void workerLoop(int worker)
+    {
+        unsigned long long seenBatch = 0;
+
+        while (true)
+        {
+            const std::function<void(size_t, int)> *task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this, seenBatch]
+                            { return stopping || (batch != seenBatch && currentTask != nullptr); });
+                if (stopping)
+                    return;
+
+                seenBatch = batch;
+                task = currentTask;
+                active++;
+            }
+
+            size_t index;
+            while (takeTask(worker, index))
+            {
+                try
+                {
+                    (*task)(index, worker);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!failure)
+                        failure = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                    finished.notify_all();
+            }
+
+            // run() only returns once no worker can still be holding a task of its batch.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0 && pending == 0)
+                finished.notify_all();
+        }
+    }
+
+    vector<unique_ptr<TaskQueue>> queues;
+    vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable finished;
+    const std::function<void(size_t, int)> *currentTask{};
+    size_t pending{};
+    int active{};
+    unsigned long long batch{};
+    bool stopping{};
+    std::exception_ptr failure;
+};
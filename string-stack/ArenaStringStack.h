@@ -0,0 +1,161 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <ranges>
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+using std::size_t;
+using std::span;
+using std::string;
+using std::string_view;
+using std::vector;
+
+/// String stack with the same push/pop/clear/empty/count as SimpleStringStack, but all the characters
+/// are in one growable buffer, the arena, and every item is only the offset where it ends. Pushing
+/// copies the characters once and allocates only when the arena or the index grow; popping copies
+/// nothing and returns a view of the characters, valid until the next change of the stack.
+class ArenaStringStack
+{
+
+public:
+    ArenaStringStack() = default;
+
+    /// Reserves room for <<items>> items of <<characterCount>> characters in total.
+    void reserve(size_t items, size_t characterCount)
+    {
+        ends.reserve(items);
+        characters.reserve(characterCount);
+    }
+
+    /// <<newValue>> may be a view pop returned: its characters are still in the arena, after the used ones.
+    void push(string_view newValue)
+    {
+        const size_t used = characterCount();
+        const char *arena = characters.data();
+        const bool inArena = std::less_equal<const char *>()(arena, newValue.data()) &&
+                             std::less<const char *>()(newValue.data(), arena + characters.size());
+        const size_t offset = newValue.data() - arena;
+
+        // The characters of the popped items are overwritten only now
+        if (characters.size() < used + newValue.size())
+            characters.resize(used + newValue.size());
+        const char *source = inArena ? characters.data() + offset : newValue.data();
+        std::memmove(characters.data() + used, source, newValue.size());
+        ends.push_back(used + newValue.size());
+    }
+
+    /// Pushes every string of <<values>> in order, growing the arena at most once for a sized range.
+    template <std::ranges::input_range Range>
+    void pushAll(const Range &values)
+    {
+        if constexpr (std::ranges::forward_range<Range>)
+        {
+            size_t characterTotal = characterCount();
+            size_t items = ends.size();
+            for (string_view value : values)
+            {
+                characterTotal += value.size();
+                items++;
+            }
+            reserve(items, characterTotal);
+        }
+
+        for (string_view value : values)
+            push(value);
+    }
+
+    /// The top item, removed. The view is valid until the next change of the stack; it is empty when
+    /// the stack is.
+    string_view pop()
+    {
+        if (empty())
+            return {};
+
+        const string_view top = this->top();
+        ends.pop_back();
+        return top;
+    }
+
+    /// Moves the top item into <<output>>, reusing its capacity. Returns false when the stack is empty.
+    bool pop(string &output)
+    {
+        if (empty())
+            return false;
+
+        output.assign(pop());
+        return true;
+    }
+
+    /// Pops up to output.size() items into <<output>>, the top first, and returns how many. The views
+    /// are valid until the next change of the stack.
+    size_t pop(span<string_view> output)
+    {
+        const size_t popped = std::min(output.size(), ends.size());
+        for (size_t i = 0; i < popped; i++)
+            output[i] = item(ends.size() - 1 - i);
+
+        ends.resize(ends.size() - popped);
+        return popped;
+    }
+
+    /// The top item, which must exist, left on the stack.
+    string_view top() const { return item(ends.size() - 1); }
+
+    /// Item <<index>>, counted from the bottom of the stack.
+    string_view operator[](size_t index) const { return item(index); }
+
+    /// Removes the <<items>> bottom items, moving the others down in the arena.
+    void eraseBottom(size_t items)
+    {
+        if (items == 0)
+            return;
+
+        const size_t erased = ends[items - 1];
+        characters.resize(characterCount());
+        characters.erase(characters.begin(), characters.begin() + erased);
+        ends.erase(ends.begin(), ends.begin() + items);
+        for (size_t &end : ends)
+            end -= erased;
+    }
+
+    /// O(1): the arena and the index keep their memory for the next items.
+    void clear()
+    {
+        ends.clear();
+        characters.clear();
+    }
+
+    bool empty() const
+    {
+        return ends.empty();
+    }
+
+    int count() const
+    {
+        return ends.size();
+    }
+
+    /// Characters of all the items.
+    size_t characterCount() const { return ends.empty() ? 0 : ends.back(); }
+
+    /// Characters the arena holds without growing.
+    size_t arenaCapacity() const { return characters.capacity(); }
+
+private:
+    string_view item(size_t index) const
+    {
+        const size_t begin = index == 0 ? 0 : ends[index - 1];
+        return string_view(characters.data() + begin, ends[index] - begin);
+    }
+
+    /// The characters of all the items, from the bottom one. The popped items stay after them until
+    /// the next push, so that the views pop returned point into the vector; characterCount() is the
+    /// part in use
+    vector<char> characters;
+    /// Offset after the last character of every item
+    vector<size_t> ends;
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include "HazardPointers.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <random>
+#include <utility>
+#include <algorithm>
+using std::move;
+using std::string;
+
+/// Lock-free string stack with the push/pop/clear/empty/count of SimpleStringStack, for many threads
+/// at once. It is a Treiber stack: the top is an atomic pointer to a linked list, changed by
+/// compare-and-swap, and the popped nodes are deleted through HazardPointers, as other poppers may
+/// still be reading them.
+/// When the compare-and-swap fails because of contention, the thread tries the elimination array
+/// instead: a pusher offers its node in a random slot for a moment, and a popper that finds a node
+/// there takes it. Such a push and pop cancel out without touching the top.
+class ConcurrentStringStack
+{
+
+public:
+    static constexpr int ELIMINATION_SLOTS = 16;
+    /// Iterations a pusher waits for a popper to take its offer
+    static constexpr int OFFER_SPINS = 64;
+
+    ConcurrentStringStack() = default;
+    ConcurrentStringStack(const ConcurrentStringStack &) = delete;
+    ConcurrentStringStack &operator=(const ConcurrentStringStack &) = delete;
+
+    /// No thread may use the stack any more.
+    ~ConcurrentStringStack()
+    {
+        for (Node *node = top.load(); node != nullptr;)
+        {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    void push(string newValue)
+    {
+        Node *node = new Node{move(newValue), top.load(std::memory_order_relaxed)};
+        while (true)
+        {
+            if (top.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+            {
+                approximateCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            if (offer(node))
+                return;
+            node->next = top.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// The top item, removed, or an empty string when the stack is empty.
+    string pop()
+    {
+        string output;
+        pop(output);
+        return output;
+    }
+
+    /// Moves the top item into <<output>>. Returns false when the stack is empty.
+    bool pop(string &output)
+    {
+        while (true)
+        {
+            // The top node cannot be deleted while it is read
+            Node *node = HazardPointers::protect(top);
+            if (node == nullptr)
+            {
+                HazardPointers::clear();
+                return false;
+            }
+
+            Node *next = node->next;
+            if (top.compare_exchange_weak(node, next, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                HazardPointers::clear();
+                output = move(node->value);
+                HazardPointers::retire(node);
+                approximateCount.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            HazardPointers::clear();
+            if (Node *offered = takeOffer())
+            {
+                output = move(offered->value);
+                delete offered;
+                return true;
+            }
+        }
+    }
+
+    void clear()
+    {
+        string ignored;
+        while (pop(ignored))
+            ;
+    }
+
+    bool empty() const
+    {
+        return top.load() == nullptr;
+    }
+
+    /// Without locks, so only approximate while other threads push or pop.
+    int count() const
+    {
+        return std::max(0LL, approximateCount.load(std::memory_order_relaxed));
+    }
+
+private:
+    struct Node
+    {
+        string value;
+        Node *next;
+    };
+
+    static int randomSlot()
+    {
+        thread_local std::minstd_rand generator(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return generator() % ELIMINATION_SLOTS;
+    }
+
+    /// Offers <<node>> to a popper for a moment. Returns true if one took it.
+    bool offer(Node *node)
+    {
+        std::atomic<Node *> &slot = elimination[randomSlot()].node;
+        Node *empty = nullptr;
+        if (!slot.compare_exchange_strong(empty, node, std::memory_order_release, std::memory_order_relaxed))
+            return false;
+
+        for (int spin = 0; spin < OFFER_SPINS; spin++)
+            if (slot.load(std::memory_order_relaxed) != node)
+                return true;
+
+        // Withdraw the offer, unless a popper takes it first
+        Node *offered = node;
+        return !slot.compare_exchange_strong(offered, nullptr, std::memory_order_relaxed);
+    }
+
+    /// A node offered by a pusher, now owned by the caller, or null.
+    Node *takeOffer()
+    {
+        std::atomic<Node *> &slot = elimination[randomSlot()].node;
+        // Only compared, never read, until taken: it needs no hazard pointer
+        Node *node = slot.load(std::memory_order_relaxed);
+        if (node != nullptr && slot.compare_exchange_strong(node, nullptr, std::memory_order_acquire, std::memory_order_relaxed))
+            return node;
+
+        return nullptr;
+    }
+
+    struct alignas(64) EliminationSlot
+    {
+        std::atomic<Node *> node{nullptr};
+    };
+
+    alignas(64) std::atomic<Node *> top{nullptr};
+    alignas(64) std::atomic<long long> approximateCount{0};
+    EliminationSlot elimination[ELIMINATION_SLOTS];
+};
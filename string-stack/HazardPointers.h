@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <exception>
+using std::exception;
+using std::vector;
+
+class TooManyHazardThreadsException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "Too many threads use hazard pointers at the same time. The limit is HazardPointers::MAX_THREADS.";
+    }
+};
+
+/// Hazard pointers, one per thread, for lock-free structures whose nodes are deleted while other
+/// threads may still read them. A thread protect()s the node before dereferencing it, and a node
+/// removed from the structure is retire()d instead of deleted: it is deleted once no hazard pointer
+/// points to it. Every thread keeps its retired nodes and scans the hazard pointers once it has
+/// RETIRED_BEFORE_SCAN of them, so the memory waiting for deletion stays bounded.
+namespace HazardPointers
+{
+    constexpr int MAX_THREADS = 256;
+    constexpr size_t RETIRED_BEFORE_SCAN = 2 * MAX_THREADS;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<void *> pointer{nullptr};
+        std::atomic<bool> taken{false};
+    };
+
+    inline Slot slots[MAX_THREADS];
+
+    struct Retired
+    {
+        void *pointer;
+        void (*destroy)(void *);
+    };
+
+    /// Nodes retired by threads that ended while the nodes were still protected
+    inline vector<Retired> orphans;
+    inline std::mutex orphansMutex;
+
+    /// Deletes the retired nodes that no hazard pointer protects, keeps the others.
+    inline void reclaim(vector<Retired> &retired)
+    {
+        vector<void *> hazards;
+        hazards.reserve(MAX_THREADS);
+        for (const Slot &slot : slots)
+            if (void *pointer = slot.pointer.load())
+                hazards.push_back(pointer);
+        std::sort(hazards.begin(), hazards.end());
+
+        std::erase_if(retired, [&hazards](const Retired &node)
+                      {
+                          if (std::binary_search(hazards.begin(), hazards.end(), node.pointer))
+                              return false;
+                          node.destroy(node.pointer);
+                          return true; });
+    }
+
+    /// Hazard pointer and retired nodes of the calling thread, claimed on first use.
+    struct ThreadSlot
+    {
+        ThreadSlot()
+        {
+            for (index = 0; index < MAX_THREADS; index++)
+            {
+                bool expected = false;
+                if (slots[index].taken.compare_exchange_strong(expected, true))
+                    return;
+            }
+
+            throw TooManyHazardThreadsException();
+        }
+
+        ~ThreadSlot()
+        {
+            slots[index].pointer.store(nullptr);
+            reclaim(retired);
+
+            std::lock_guard<std::mutex> lock(orphansMutex);
+            orphans.insert(orphans.end(), retired.begin(), retired.end());
+            reclaim(orphans);
+            slots[index].taken.store(false);
+        }
+
+        int index;
+        vector<Retired> retired;
+    };
+
+    inline thread_local ThreadSlot threadSlot;
+
+    /// Reads <<source>> and protects the node it points to until clear(): the node is not deleted,
+    /// even if it is removed from the structure meanwhile.
+    template <class Node>
+    Node *protect(const std::atomic<Node *> &source)
+    {
+        Slot &slot = slots[threadSlot.index];
+        Node *node = source.load();
+        while (true)
+        {
+            slot.pointer.store(node);
+            // Still reachable after the hazard pointer is visible: no thread can have retired it yet
+            Node *current = source.load();
+            if (current == node)
+                return node;
+            node = current;
+        }
+    }
+
+    inline void clear() { slots[threadSlot.index].pointer.store(nullptr, std::memory_order_release); }
+
+    /// Deletes <<node>>, already removed from the structure, once no thread protects it.
+    template <class Node>
+    void retire(Node *node)
+    {
+        vector<Retired> &retired = threadSlot.retired;
+        retired.push_back(Retired{node, [](void *pointer)
+                                  { delete static_cast<Node *>(pointer); }});
+        if (retired.size() >= RETIRED_BEFORE_SCAN)
+            reclaim(retired);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+class SimpleStringStack
+{
+
+public:
+    SimpleStringStack() = default;
+    void push(const string newValue)
+    {
+        stack.push_back(newValue);
+    };
+
+    /// It is not really a pop, neither a top as defined in std::stack type.
+    string pop()
+    {
+        if (empty())
+            return "";
+
+        string top = stack[stack.size() - 1];
+        stack.erase(stack.end() - 1);
+
+        return top;
+    };
+
+    void clear()
+    {
+        stack.clear();
+    }
+
+    bool empty()
+    {
+        return stack.empty();
+    }
+
+    int count()
+    {
+        return stack.size();
+    }
+
+private:
+    vector<string> stack;
+};
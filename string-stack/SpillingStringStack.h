@@ -0,0 +1,347 @@
+#pragma once
+#include "ArenaStringStack.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using std::exception;
+using std::size_t;
+using std::string;
+using std::string_view;
+using std::vector;
+
+class SpillFileException : public exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The spill file of the stack cannot be opened, written or mapped, or it is not a spill file.";
+    }
+};
+
+/// What SpillingStringStack does with its file when it is destroyed.
+enum SpillFile
+{
+    /// The file is removed: it only extends the memory of the stack
+    DELETE_ON_CLOSE,
+    /// The items still in memory are spilled too, so the file holds the whole stack; opening the
+    /// same path again with KEEP_ON_CLOSE restores it. The destructor cannot report a failure to
+    /// write them: call flush() first to handle it
+    KEEP_ON_CLOSE
+};
+
+/// String stack for more items than fit in memory. The top items are in an ArenaStringStack, so
+/// push and pop work as fast as there; when its items and characters take more than the memory
+/// budget, the bottom half of them is written at the end of the spill file as a segment. The file
+/// is a stack of segments as well: once the memory is empty, pop maps the last segment, reads it
+/// from the top down as the pages come in, and truncates the file when the segment is empty.
+class SpillingStringStack
+{
+
+public:
+    SpillingStringStack(const string &pathParam, size_t memoryBudgetParam, SpillFile modeParam = DELETE_ON_CLOSE)
+        : path(pathParam), memoryBudget(memoryBudgetParam), mode(modeParam), pageSize(sysconf(_SC_PAGESIZE))
+    {
+        const int flags = mode == KEEP_ON_CLOSE ? O_RDWR | O_CREAT : O_RDWR | O_CREAT | O_TRUNC;
+        file = open(path.c_str(), flags, 0644);
+        if (file < 0)
+            throw SpillFileException();
+
+        try
+        {
+            struct stat status;
+            if (fstat(file, &status) != 0)
+                throw SpillFileException();
+            if (status.st_size == 0)
+                writeFileHeader();
+            else
+                readSegments(status.st_size);
+        }
+        catch (const SpillFileException &)
+        {
+            close(file);
+            throw;
+        }
+    }
+
+    SpillingStringStack(const SpillingStringStack &) = delete;
+    SpillingStringStack &operator=(const SpillingStringStack &) = delete;
+
+    /// Best effort: a KEEP_ON_CLOSE stack whose items cannot be written keeps the segments written
+    /// before.
+    ~SpillingStringStack()
+    {
+        if (mode == KEEP_ON_CLOSE)
+        {
+            try
+            {
+                flush();
+            }
+            catch (const SpillFileException &)
+            {
+            }
+        }
+        else
+            unlink(path.c_str());
+
+        unmapSegment();
+        close(file);
+    }
+
+    /// <<newValue>> may be a view pop returned, even into a segment emptied by that pop.
+    void push(string_view newValue)
+    {
+        // Copied before the emptied segment is unmapped
+        memory.push(newValue);
+        releaseEmptySegment();
+        if (memoryBytes() > memoryBudget)
+            spill((memory.count() + 1) / 2);
+    }
+
+    /// The top item, removed, or an empty view when the stack is empty. The view is valid until the
+    /// next change of the stack.
+    string_view pop()
+    {
+        releaseEmptySegment();
+        if (!memory.empty())
+            return memory.pop();
+
+        // The memory is empty: the top is in the last segment of the file
+        while (!segments.empty())
+        {
+            mapLastSegment();
+            SegmentHeader *header = mappedHeader();
+            if (header->itemCount == 0)
+            {
+                releaseEmptySegment();
+                continue;
+            }
+
+            const std::uint64_t *ends = reinterpret_cast<const std::uint64_t *>(header + 1);
+            const char *characters = reinterpret_cast<const char *>(ends + header->capacity);
+            const std::uint64_t index = header->itemCount - 1;
+            const std::uint64_t begin = index == 0 ? 0 : ends[index - 1];
+            if (begin > ends[index] || characters + ends[index] > static_cast<const char *>(mapped) + mappedBytes)
+                throw SpillFileException();
+
+            header->itemCount--;
+            spilledCount--;
+            return string_view(characters + begin, ends[index] - begin);
+        }
+
+        return {};
+    }
+
+    /// Copies the top item into <<output>>. Returns false when the stack is empty.
+    bool pop(string &output)
+    {
+        if (empty())
+            return false;
+
+        output.assign(pop());
+        return true;
+    }
+
+    /// Writes the items in memory to the file and waits until it is on disk, so the file holds the
+    /// whole stack. Throws SpillFileException when they cannot be written, e.g. when the disk is full;
+    /// the stack is unchanged then.
+    void flush()
+    {
+        releaseEmptySegment();
+        spill(memory.count());
+        if (fsync(file) != 0)
+            throw SpillFileException();
+    }
+
+    /// Empties the memory and truncates the file.
+    void clear()
+    {
+        memory.clear();
+        unmapSegment();
+        segments.clear();
+        spilledCount = 0;
+        resizeFile(pageSize);
+    }
+
+    bool empty() const
+    {
+        return memory.empty() && spilledCount == 0;
+    }
+
+    size_t count() const
+    {
+        return memory.count() + spilledCount;
+    }
+
+    /// Items written to the file and not popped yet.
+    size_t spilled() const { return spilledCount; }
+
+    /// Bytes taken by the items in memory, kept under the memory budget.
+    size_t memoryBytes() const { return memory.characterCount() + memory.count() * sizeof(size_t); }
+
+private:
+    /// The first page of the file
+    struct FileHeader
+    {
+        std::uint64_t magic;
+        std::uint64_t version;
+    };
+
+    /// At the beginning of every segment, followed by the end offsets of its items and their characters
+    struct SegmentHeader
+    {
+        /// Items not popped yet, the first ones of the segment
+        std::uint64_t itemCount;
+        /// Items written in the segment
+        std::uint64_t capacity;
+        /// Bytes of the segment, a whole number of pages
+        std::uint64_t bytes;
+    };
+
+    static constexpr std::uint64_t MAGIC = 0x4b43415453475053; // "SPGSTACK"
+    static constexpr std::uint64_t VERSION = 1;
+
+    void writeFileHeader()
+    {
+        resizeFile(pageSize);
+        const FileHeader header{MAGIC, VERSION};
+        if (pwrite(file, &header, sizeof(header), 0) != sizeof(header))
+            throw SpillFileException();
+    }
+
+    /// Finds the segments of an existing file, walking their headers from the first one.
+    void readSegments(std::uint64_t fileBytes)
+    {
+        FileHeader header;
+        if (pread(file, &header, sizeof(header), 0) != sizeof(header) || header.magic != MAGIC || header.version != VERSION)
+            throw SpillFileException();
+
+        for (std::uint64_t offset = pageSize; offset < fileBytes;)
+        {
+            SegmentHeader segment;
+            if (pread(file, &segment, sizeof(segment), offset) != sizeof(segment) || segment.bytes == 0)
+                throw SpillFileException();
+
+            // A truncated or overwritten file must not be mapped past its end
+            const std::uint64_t maximumCapacity = segment.bytes < sizeof(SegmentHeader) ? 0 : (segment.bytes - sizeof(SegmentHeader)) / sizeof(std::uint64_t);
+            if (segment.bytes > fileBytes - offset || segment.capacity > maximumCapacity || segment.itemCount > segment.capacity)
+                throw SpillFileException();
+
+            segments.push_back(offset);
+            spilledCount += segment.itemCount;
+            offset += segment.bytes;
+        }
+        fileSize = fileBytes;
+    }
+
+    /// Writes the <<items>> bottom items in memory as a new segment at the end of the file.
+    void spill(size_t items)
+    {
+        if (items == 0)
+            return;
+
+        const size_t characterBytes = memory[items - 1].data() + memory[items - 1].size() - memory[0].data();
+        const std::uint64_t bytes = roundToPages(sizeof(SegmentHeader) + items * sizeof(std::uint64_t) + characterBytes);
+        const std::uint64_t offset = fileSize;
+        resizeFile(offset + bytes);
+
+        // Written sequentially through a mapping of the new segment only
+        void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, offset);
+        if (mapping == MAP_FAILED)
+        {
+            // The stack stays as it was: the items are still in memory
+            if (ftruncate(file, offset) == 0)
+                fileSize = offset;
+            throw SpillFileException();
+        }
+
+        SegmentHeader *header = static_cast<SegmentHeader *>(mapping);
+        *header = SegmentHeader{items, items, bytes};
+        std::uint64_t *ends = reinterpret_cast<std::uint64_t *>(header + 1);
+        char *characters = reinterpret_cast<char *>(ends + items);
+        for (size_t item = 0; item < items; item++)
+            ends[item] = memory[item].data() + memory[item].size() - memory[0].data();
+        std::memcpy(characters, memory[0].data(), characterBytes);
+        munmap(mapping, bytes);
+
+        segments.push_back(offset);
+        spilledCount += items;
+        memory.eraseBottom(items);
+    }
+
+    void mapLastSegment()
+    {
+        const std::uint64_t offset = segments.back();
+        if (mapped != nullptr && mappedOffset == offset)
+            return;
+
+        unmapSegment();
+        SegmentHeader header;
+        if (pread(file, &header, sizeof(header), offset) != sizeof(header))
+            throw SpillFileException();
+
+        mapped = mmap(nullptr, header.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, offset);
+        if (mapped == MAP_FAILED)
+        {
+            mapped = nullptr;
+            throw SpillFileException();
+        }
+        mappedOffset = offset;
+        mappedBytes = header.bytes;
+        // Popped from the top down
+        madvise(mapped, mappedBytes, MADV_SEQUENTIAL);
+    }
+
+    SegmentHeader *mappedHeader() const { return static_cast<SegmentHeader *>(mapped); }
+
+    /// Truncates the file when its last segment has been emptied, once the views into it are no longer used.
+    void releaseEmptySegment()
+    {
+        if (mapped == nullptr || segments.empty() || mappedOffset != segments.back() || mappedHeader()->itemCount > 0)
+            return;
+
+        unmapSegment();
+        segments.pop_back();
+        // The segments are contiguous: the emptied one began where the file now ends
+        resizeFile(mappedOffset);
+    }
+
+    void unmapSegment()
+    {
+        if (mapped == nullptr)
+            return;
+
+        munmap(mapped, mappedBytes);
+        mapped = nullptr;
+    }
+
+    void resizeFile(std::uint64_t bytes)
+    {
+        if (ftruncate(file, bytes) != 0)
+            throw SpillFileException();
+        fileSize = bytes;
+    }
+
+    std::uint64_t roundToPages(std::uint64_t bytes) const { return (bytes + pageSize - 1) / pageSize * pageSize; }
+
+    string path;
+    size_t memoryBudget;
+    SpillFile mode;
+    std::uint64_t pageSize;
+    int file{-1};
+    std::uint64_t fileSize{};
+
+    ArenaStringStack memory;
+    /// Offsets of the segments in the file, the last one on top
+    vector<std::uint64_t> segments;
+    size_t spilledCount{};
+    void *mapped{};
+    std::uint64_t mappedOffset{};
+    std::uint64_t mappedBytes{};
+};
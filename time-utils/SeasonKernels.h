@@ -0,0 +1,172 @@
+#pragma once
+#include "TimeUtils.h"
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+using std::size_t;
+using std::span;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SEASON_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+class BatchSizeMismatchException : public std::exception
+{
+    virtual const char *what() const throw()
+    {
+        return "The day, month, latitude and season spans must have the same size, and the validity span one bit per record.";
+    }
+};
+
+/// getSeason and isValidDay over columns of records: the days, months and latitudes in separate
+/// arrays. Every record gets its Season code, and a bit of the validity mask that is set when the
+/// date is valid, when getSeason would not throw; invalid records get code 0. Both kernels read the
+/// TimeUtils::SeasonTable entries; the AVX2 one classifies 8 records with one gather. The functions
+/// outside the nested namespaces pick the AVX2 one at runtime when the processor supports it.
+namespace SeasonKernels
+{
+    inline bool avx2Supported()
+    {
+#ifdef SEASON_AVX2_KERNELS
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    constexpr std::uint8_t INVALID = TimeUtils::SeasonTable::INVALID_DAY | TimeUtils::SeasonTable::INVALID_MONTH;
+
+    namespace scalar
+    {
+        /// Classifies the records from <<first>> to <<count>>; their validity bits must be zero.
+        /// Returns the valid ones.
+        inline size_t classify(const int *days, const int *months, const double *latitudes, size_t first, size_t count,
+                               std::uint8_t *seasons, std::uint64_t *validity)
+        {
+            using namespace TimeUtils::SeasonTable;
+            size_t valid = 0;
+            for (size_t i = first; i < count;)
+            {
+                // One word of the mask at a time. Valid dates are the common case: the entries are
+                // only or'ed together, which costs less than building the mask bit by bit
+                const size_t wordEnd = std::min(count, (i / 64 + 1) * 64);
+                std::uint8_t allEntries = 0;
+                for (size_t j = i; j < wordEnd; j++)
+                {
+                    const std::uint8_t entry = lookup(days[j], months[j], latitudes[j]);
+                    seasons[j] = entry & SEASON_BITS;
+                    allEntries |= entry;
+                }
+
+                if ((allEntries & INVALID) == 0)
+                {
+                    const size_t records = wordEnd - i;
+                    validity[i / 64] |= (records == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << records) - 1) << (i % 64);
+                    valid += records;
+                    i = wordEnd;
+                    continue;
+                }
+
+                // Some date of the word is invalid: the mask is built record by record
+                std::uint64_t bits = 0;
+                for (; i < wordEnd; i++)
+                {
+                    const bool isValid = (lookup(days[i], months[i], latitudes[i]) & INVALID) == 0;
+                    bits |= std::uint64_t(isValid) << (i % 64);
+                    valid += isValid;
+                }
+                validity[(wordEnd - 1) / 64] |= bits;
+            }
+            return valid;
+        }
+    }
+
+#ifdef SEASON_AVX2_KERNELS
+    namespace avx2
+    {
+        /// Classifies the records from 0 to <<count>>; their validity bits must be zero. Returns the
+        /// valid ones.
+        __attribute__((target("avx2,popcnt"))) inline size_t classify(const int *days, const int *months, const double *latitudes,
+                                                                      size_t count, std::uint8_t *seasons, std::uint64_t *validity)
+        {
+            using namespace TimeUtils::SeasonTable;
+            const __m256i monthLimit = _mm256_set1_epi32(MONTHS - 1);
+            const __m256i dayLimit = _mm256_set1_epi32(DAYS - 1);
+            const __m256i northOffset = _mm256_set1_epi32(index(true, 0, 0));
+            const __m256i lowHalves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+            const __m256i entryBytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+            const __m256i invalidBits = _mm256_set1_epi32(INVALID);
+            const __m256i seasonBits = _mm256_set1_epi32(SEASON_BITS);
+            const __m256d zero = _mm256_setzero_pd();
+
+            size_t valid = 0;
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m256i day = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(days + i));
+                const __m256i month = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(months + i));
+
+                // One 64-bit comparison mask per latitude, narrowed to one 32-bit lane per record
+                const __m256i northLow = _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(latitudes + i), zero, _CMP_GT_OQ));
+                const __m256i northHigh = _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(latitudes + i + 4), zero, _CMP_GT_OQ));
+                const __m256i north = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(northLow, lowHalves),
+                                                         _mm256_permutevar8x32_epi32(northHigh, lowHalves), 0xF0);
+
+                // Out of the table, as unsigned numbers, becomes row or column 0, like in lookup
+                const __m256i row = _mm256_and_si256(month, _mm256_cmpeq_epi32(_mm256_min_epu32(month, monthLimit), month));
+                const __m256i column = _mm256_and_si256(day, _mm256_cmpeq_epi32(_mm256_min_epu32(day, dayLimit), day));
+                const __m256i offsets = _mm256_add_epi32(_mm256_and_si256(north, northOffset),
+                                                         _mm256_add_epi32(_mm256_slli_epi32(row, 5), column));
+
+                // 4 bytes from every entry: the entry and the next ones, masked out
+                const __m256i entries32 = _mm256_i32gather_epi32(reinterpret_cast<const int *>(entries.data()), offsets, 1);
+                const __m256i isValid = _mm256_cmpeq_epi32(_mm256_and_si256(entries32, invalidBits), _mm256_setzero_si256());
+                const __m256i codes = _mm256_shuffle_epi8(_mm256_and_si256(entries32, seasonBits), entryBytes);
+
+                const std::uint32_t lowCodes = _mm256_extract_epi32(codes, 0);
+                const std::uint32_t highCodes = _mm256_extract_epi32(codes, 4);
+                const std::uint64_t bytes = lowCodes | std::uint64_t(highCodes) << 32;
+                std::memcpy(seasons + i, &bytes, sizeof(bytes));
+
+                const std::uint64_t bits = _mm256_movemask_ps(_mm256_castsi256_ps(isValid));
+                validity[i / 64] |= bits << (i % 64);
+                valid += _mm_popcnt_u32(bits);
+            }
+
+            return valid + scalar::classify(days, months, latitudes, i, count, seasons, validity);
+        }
+    }
+#endif
+
+    /// Words of the validity mask of <<records>> records.
+    constexpr size_t validityWords(size_t records) { return (records + 63) / 64; }
+
+    /// Writes the Season of every record in <<seasons>>, and sets bit i % 64 of validity[i / 64] when
+    /// record i is valid. Returns the number of valid records.
+    inline size_t classify(span<const int> days, span<const int> months, span<const double> latitudes,
+                           span<std::uint8_t> seasons, span<std::uint64_t> validity)
+    {
+        const size_t count = days.size();
+        if (months.size() != count || latitudes.size() != count || seasons.size() != count || validity.size() < validityWords(count))
+            throw BatchSizeMismatchException();
+
+        std::fill(validity.begin(), validity.begin() + validityWords(count), 0);
+#ifdef SEASON_AVX2_KERNELS
+        if (avx2Supported())
+            return avx2::classify(days.data(), months.data(), latitudes.data(), count, seasons.data(), validity.data());
+#endif
+        return scalar::classify(days.data(), months.data(), latitudes.data(), 0, count, seasons.data(), validity.data());
+    }
+
+    /// Whether record <<index>> is valid in <<validity>>.
+    inline bool isValid(span<const std::uint64_t> validity, size_t index)
+    {
+        return validity[index / 64] >> (index % 64) & 1;
+    }
+}
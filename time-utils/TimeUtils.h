@@ -0,0 +1,159 @@
+#pragma once
+#include <string>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+class InvalidDate : public std::exception
+{
+public:
+    InvalidDate(bool invalidDay, bool invalidMonth)
+    {
+        if (invalidDay && invalidMonth)
+            message = "Invalid day and month";
+        else if (!invalidDay)
+            message = "Invalid day";
+        else if (!invalidMonth)
+            message = "Invalid month";
+    }
+
+    virtual const char *what() const throw()
+    {
+        return "Invalid month";
+    }
+
+private:
+    std::string message;
+};
+
+namespace TimeUtils
+{
+    enum Season
+    {
+        SUMMER,
+        WINTER,
+        SPRING,
+        FALL
+    };
+
+    constexpr bool isValidMonth(int month)
+    {
+        return month >= 1 && month <= 12;
+    }
+
+    constexpr int monthDays(int month)
+    {
+        if (!isValidMonth(month))
+            throw InvalidDate(false, true);
+
+        if (month == 2)
+            return 28;
+        if (month == 4 || month == 6 || month == 9 || month == 11)
+            return 30;
+        else
+            return 31;
+    }
+
+    constexpr bool isValidDay(int day, int month)
+    {
+        return day > 0 && day <= monthDays(month);
+    }
+
+    /// getSeason with a remap of the month and a switch, used to generate the season table. Does not
+    /// validate latitude.
+    constexpr Season getSeasonBySwitch(int day, int month, double latitude)
+    {
+        bool isInvalidMonth = !isValidMonth(month);
+        bool isInvalidDay = !isValidDay(day, month);
+
+        if (isInvalidMonth || isInvalidDay)
+            throw InvalidDate(isInvalidDay, isInvalidMonth);
+
+        if (month % 3 == 0)
+            month = day < 23 ? month - 1 : (month + 1) % 12;
+
+        switch (month)
+        {
+        case 1:
+        case 2:
+            return latitude > 0 ? Season::WINTER : Season::SUMMER;
+        case 4:
+        case 5:
+            return latitude > 0 ? Season::SPRING : Season::FALL;
+        case 7:
+        case 8:
+            return latitude > 0 ? Season::SUMMER : Season::WINTER;
+        case 10:
+        case 11:
+            return latitude > 0 ? Season::FALL : Season::SPRING;
+        default:
+            // It could be marked [[unlikely]] on C++20
+            throw InvalidDate(isInvalidDay, isInvalidMonth);
+        }
+    }
+
+    /// The season of every date of both hemispheres, generated at compile time. An entry is the
+    /// Season in its low bits, or'ed with INVALID_DAY or INVALID_MONTH when getSeason throws for it.
+    /// Months and days out of the table are mapped to month 0 and day 0, which are invalid.
+    namespace SeasonTable
+    {
+        constexpr int MONTHS = 13;
+        constexpr int DAYS = 32;
+        constexpr std::uint8_t SEASON_BITS = 0x3;
+        constexpr std::uint8_t INVALID_DAY = 0x4;
+        constexpr std::uint8_t INVALID_MONTH = 0x8;
+
+        constexpr int index(bool north, int month, int day) { return (north * MONTHS + month) * DAYS + day; }
+
+        constexpr std::uint8_t entry(bool north, int month, int day)
+        {
+            if (!isValidMonth(month))
+                return INVALID_MONTH;
+            if (!isValidDay(day, month))
+                return INVALID_DAY;
+            return getSeasonBySwitch(day, month, north ? 1 : -1);
+        }
+
+        constexpr int SIZE = 2 * MONTHS * DAYS;
+        /// Zeros after the entries, so that SeasonKernels can gather any entry with a 32-bit load
+        constexpr int PADDING = 3;
+
+        constexpr std::array<std::uint8_t, SIZE + PADDING> generate()
+        {
+            std::array<std::uint8_t, SIZE + PADDING> table{};
+            for (int north = 0; north < 2; north++)
+                for (int month = 0; month < MONTHS; month++)
+                    for (int day = 0; day < DAYS; day++)
+                        table[index(north, month, day)] = entry(north, month, day);
+            return table;
+        }
+
+        alignas(64) inline constexpr std::array<std::uint8_t, SIZE + PADDING> entries = generate();
+
+        /// The table entry of any date: one load, the bounds checks compile to conditional moves.
+        inline std::uint8_t lookup(int day, int month, double latitude)
+        {
+            const int row = static_cast<unsigned>(month) < MONTHS ? month : 0;
+            const int column = static_cast<unsigned>(day) < DAYS ? day : 0;
+            return entries[index(latitude > 0, row, column)];
+        }
+    }
+
+    // Does not validate latitude.
+    inline Season getSeason(int day, int month, double latitude)
+    {
+        const std::uint8_t entry = SeasonTable::lookup(day, month, latitude);
+        if (entry & SeasonTable::INVALID_MONTH) [[unlikely]]
+            throw InvalidDate(false, true);
+        if (entry & SeasonTable::INVALID_DAY) [[unlikely]]
+            throw InvalidDate(true, false);
+
+        return static_cast<Season>(entry);
+    }
+
+    inline bool isSummer(int day, int month, double latitude)
+    {
+        return getSeason(day, month, latitude) == Season::SUMMER;
+    }
+}